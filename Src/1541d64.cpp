@@ -1524,7 +1524,7 @@ void ImageDrive::mem_read_cmd(uint16 adr, uint8 len)
 		error_ptr = (char *)ram + (adr & 0x7ff);
 	} else if (adr >= 0xc000) {
 		// Read from ROM
-		error_ptr = (char *)(TheC64->ROM1541) + (adr - 0xc000);
+		error_ptr = (char *)(the_iec->TheC64->ROM1541) + (adr - 0xc000);
 	} else {
 		unsupp_cmd();
 		memset(error_buf, 0, len);
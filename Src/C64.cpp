@@ -31,6 +31,7 @@
 #include "1541job.h"
 #include "Display.h"
 #include "Prefs.h"
+#include "Rewind.h"
 
 #ifdef FRODO_SC
 bool IsFrodoSC = true;
@@ -77,9 +78,9 @@ C64::C64()
 
 	TheVIC = TheCPU->TheVIC = new MOS6569(this, TheDisplay, TheCPU, RAM, Char, Color);
 	TheSID = TheCPU->TheSID = new MOS6581(this);
-	TheCIA1 = TheCPU->TheCIA1 = new MOS6526_1(TheCPU, TheVIC);
-	TheCIA2 = TheCPU->TheCIA2 = TheCPU1541->TheCIA2 = new MOS6526_2(TheCPU, TheVIC, TheCPU1541);
-	TheIEC = TheCPU->TheIEC = new IEC(TheDisplay);
+	TheCIA1 = TheCPU->TheCIA1 = new MOS6526_1(this, TheCPU, TheVIC);
+	TheCIA2 = TheCPU->TheCIA2 = TheCPU1541->TheCIA2 = new MOS6526_2(this, TheCPU, TheVIC, TheCPU1541);
+	TheIEC = TheCPU->TheIEC = new IEC(this, TheDisplay);
 	TheREU = TheCPU->TheREU = new REU(TheCPU);
 
 	// Initialize RAM with powerup pattern
@@ -99,6 +100,11 @@ C64::C64()
 	// Clear 1541 RAM
 	memset(RAM1541, 0, DRIVE_RAM_SIZE);
 
+	// No in-memory snapshots yet
+	memset(RAMDirty, 0, sizeof(RAMDirty));
+	memset(page_epoch, 0, sizeof(page_epoch));
+	snap_epoch = 0;
+
 	// Open joystick drivers if required
 	open_joystick(0);
 	open_joystick(1);
@@ -106,6 +112,10 @@ C64::C64()
 
 #ifdef FRODO_SC
 	CycleCounter = 0;
+	EventClock = 0;
+	for (int i=0; i<NUM_EVENTS; i++)
+		event_cycle[i] = 0;
+	next_event_cycle = 0;
 #endif
 
 	// System-dependent things
@@ -170,6 +180,30 @@ void C64::NMI(void)
 }
 
 
+#ifdef FRODO_SC
+/*
+ *  Clock all event sources whose cycle has been reached
+ *  and find the next cycle at which something is due
+ */
+
+void C64::dispatch_events(void)
+{
+	// The order of calls is important here
+	if ((int32)(EventClock - event_cycle[EVENT_CIA1]) >= 0)
+		TheCIA1->EmulateEvent();
+	if ((int32)(EventClock - event_cycle[EVENT_CIA2]) >= 0)
+		TheCIA2->EmulateEvent();
+	if ((int32)(EventClock - event_cycle[EVENT_VIA2]) >= 0)
+		TheCPU1541->EmulateEvent();
+
+	next_event_cycle = event_cycle[0];
+	for (int i=1; i<NUM_EVENTS; i++)
+		if ((int32)(event_cycle[i] - next_event_cycle) < 0)
+			next_event_cycle = event_cycle[i];
+}
+#endif
+
+
 /*
  *  The preferences have changed. prefs is a pointer to the new
  *   preferences, ThePrefs still holds the previous ones.
@@ -188,6 +222,14 @@ void C64::NewPrefs(Prefs *prefs)
 	TheREU->NewPrefs(prefs);
 	TheSID->NewPrefs(prefs);
 
+	// Resize the rewind buffer
+	if (prefs->RewindMemory != ThePrefs.RewindMemory) {
+		delete rewind_buffer;
+		rewind_buffer = NULL;
+		if (prefs->RewindMemory > 0)
+			rewind_buffer = new RewindBuffer(this, prefs->RewindMemory * 1024);
+	}
+
 	// Reset 1541 processor if turned on
 	if (!ThePrefs.Emul1541Proc && prefs->Emul1541Proc)
 		TheCPU1541->AsyncReset();
@@ -258,6 +300,12 @@ void C64::PatchKernal(bool fast_reset, bool emul_1541_proc)
 	ROM1541[0x3598] = 0x01;
 	ROM1541[0x3b0c] = 0xf2;		// Format track
 	ROM1541[0x3b0d] = 0x02;
+
+#ifdef FRODO_SC
+	TheCPU1541->DecodeROM();
+#elif DECODE_CACHE
+	TheCPU->DecodeROM();
+#endif
 }
 
 
@@ -316,6 +364,7 @@ bool C64::LoadCPUState(FILE *f)
 	int i = fread(RAM, 0x10000, 1, f);
 	i += fread(Color, 0x400, 1, f);
 	i += fread((void*)&state, sizeof(state), 1, f);
+	memset(RAMDirty, true, sizeof(RAMDirty));
 
 	if (i == 3) {
 		TheCPU->SetState(&state);
@@ -491,16 +540,17 @@ bool C64::Load1541JobState(FILE *f)
 #define SNAPSHOT_HEADER "FrodoSnapshot"
 #define SNAPSHOT_1541 1
 
+#define EMULATE_EVENTS \
+	EventClock++; \
+	if ((int32)(EventClock - next_event_cycle) >= 0) \
+		dispatch_events();
+
 #define ADVANCE_CYCLES	\
 	TheVIC->EmulateCycle(); \
-	TheCIA1->EmulateCycle(); \
-	TheCIA2->EmulateCycle(); \
+	EMULATE_EVENTS; \
 	TheCPU->EmulateCycle(); \
-	if (ThePrefs.Emul1541Proc) { \
-		TheCPU1541->CountVIATimers(1); \
-		if (!TheCPU1541->Idle) \
-			TheCPU1541->EmulateCycle(); \
-	}
+	if (ThePrefs.Emul1541Proc && !TheCPU1541->Idle) \
+		TheCPU1541->EmulateCycle();
 
 
 /*
@@ -620,8 +670,7 @@ bool C64::LoadSnapshot(const char *filename)
 			// Make the other chips "catch up" with the 6510
 			for (i=0; i<delay; i++) {
 				TheVIC->EmulateCycle();
-				TheCIA1->EmulateCycle();
-				TheCIA2->EmulateCycle();
+				EMULATE_EVENTS;
 			}
 #endif
 			if ((flags & SNAPSHOT_1541) != 0) {
@@ -642,8 +691,7 @@ bool C64::LoadSnapshot(const char *filename)
 				// Make the other chips "catch up" with the 6502
 				for (i=0; i<delay; i++) {
 					TheVIC->EmulateCycle();
-					TheCIA1->EmulateCycle();
-					TheCIA2->EmulateCycle();
+					EMULATE_EVENTS;
 					TheCPU->EmulateCycle();
 				}
 #endif
@@ -679,6 +727,191 @@ bool C64::LoadSnapshot(const char *filename)
 	}
 }
 
+
+/*
+ *  In-memory snapshots
+ *
+ *  CaptureSnapshot() saves the machine state into a caller-supplied arena
+ *  of SnapshotSize() bytes, RestoreSnapshot() puts it back. Both must be
+ *  called in VBlank, like the snapshot files, and an arena can only be
+ *  restored into the C64 that captured it. A new arena must be zeroed.
+ *
+ *  RAM is copied in 256 byte pages. The 6510 marks the pages it writes to
+ *  in RAMDirty[], and sync_dirty_pages() turns these marks into the epoch
+ *  in which each page last changed. The arena remembers the epoch of its
+ *  capture, so capturing into the same arena again only copies the pages
+ *  changed since then, and restoring it only copies the pages changed
+ *  since its capture. Anything else that writes to RAM directly has to
+ *  set RAMDirty[] as well. The SL 6510 doesn't mark pages, so in SL all
+ *  of RAM is copied each time.
+ *
+ *  Unlike SaveSnapshot(), FrodoSC doesn't advance the chips to the end of
+ *  the current instructions. The chips save what the snapshot files leave
+ *  out (the instructions in progress and the cycle timing) with their
+ *  GetCycleState() functions instead, so capturing doesn't disturb the
+ *  emulation and a restore continues exactly like it did after the capture.
+ */
+
+#define MEM_SNAPSHOT_MAGIC 0x46736e70	// 'Fsnp'
+
+struct MemSnapshot {
+	uint32 magic;
+	C64 *owner;				// C64 that captured the snapshot
+	uint32 epoch;			// Epoch of the capture
+	uint8 flags;			// SNAPSHOT_1541
+	MOS6569State vic;
+	MOS6581State sid;
+	MOS6581BusState sid_bus;
+	MOS6526State cia1, cia2;
+	MOS6510State cpu;
+	MOS6502State cpu1541;
+	Job1541State job;
+	uint8 cia2_iec_lines, drive_iec_lines;
+#ifdef FRODO_SC
+	MOS6569CycleState vic_cycle;
+	MOS6526CycleState cia1_cycle, cia2_cycle;
+	MOS6510CycleState cpu_cycle;
+	MOS6502CycleState cpu1541_cycle;
+#endif
+	char drive_path[256];
+	uint8 color[COLOR_RAM_SIZE];
+	uint8 ram1541[DRIVE_RAM_SIZE];
+	uint8 ram[C64_RAM_SIZE];
+};
+
+size_t C64::SnapshotSize(void)
+{
+	return sizeof(MemSnapshot);
+}
+
+
+/*
+ *  Advance the epoch and stamp the pages written since the last sync
+ */
+
+void C64::sync_dirty_pages(void)
+{
+#ifndef FRODO_SC
+	memset(RAMDirty, true, sizeof(RAMDirty));
+#endif
+	snap_epoch++;
+	for (int i=0; i<0x100; i++)
+		if (RAMDirty[i]) {
+			page_epoch[i] = snap_epoch;
+			RAMDirty[i] = false;
+		}
+}
+
+
+/*
+ *  Capture in-memory snapshot (emulation must be in VBlank)
+ */
+
+void C64::CaptureSnapshot(void *arena)
+{
+	MemSnapshot *s = (MemSnapshot *)arena;
+	bool full = s->magic != MEM_SNAPSHOT_MAGIC || s->owner != this;
+	bool emul_1541 = ThePrefs.Emul1541Proc;
+
+	TheCPU->GetState(&s->cpu);
+	TheVIC->GetState(&s->vic);
+	TheSID->GetState(&s->sid);
+	TheSID->GetBusState(&s->sid_bus);
+	TheCIA1->GetState(&s->cia1);
+	TheCIA2->GetState(&s->cia2);
+	s->cia2_iec_lines = TheCIA2->IECLines;
+#ifdef FRODO_SC
+	TheVIC->GetCycleState(&s->vic_cycle);
+	TheCIA1->GetCycleState(&s->cia1_cycle);
+	TheCIA2->GetCycleState(&s->cia2_cycle);
+	TheCPU->GetCycleState(&s->cpu_cycle);
+#endif
+	memcpy(s->color, Color, COLOR_RAM_SIZE);
+
+	s->flags = 0;
+	if (emul_1541) {
+		s->flags |= SNAPSHOT_1541;
+		TheCPU1541->GetState(&s->cpu1541);
+		TheJob1541->GetState(&s->job);
+		s->drive_iec_lines = TheCPU1541->IECLines;
+#ifdef FRODO_SC
+		TheCPU1541->GetCycleState(&s->cpu1541_cycle);
+#endif
+		memcpy(s->drive_path, ThePrefs.DrivePath[0], sizeof(s->drive_path));
+		memcpy(s->ram1541, RAM1541, DRIVE_RAM_SIZE);
+	}
+
+	// Copy the RAM pages the arena doesn't have yet
+	sync_dirty_pages();
+	for (int i=0; i<0x100; i++)
+		if (full || page_epoch[i] > s->epoch)
+			memcpy(s->ram + (i << 8), RAM + (i << 8), 0x100);
+
+	s->magic = MEM_SNAPSHOT_MAGIC;
+	s->owner = this;
+	s->epoch = snap_epoch;
+}
+
+
+/*
+ *  Restore in-memory snapshot (emulation must be in VBlank)
+ */
+
+bool C64::RestoreSnapshot(const void *arena)
+{
+	MemSnapshot *s = (MemSnapshot *)arena;
+	bool emul_1541 = (s->flags & SNAPSHOT_1541) != 0;
+
+	if (s->magic != MEM_SNAPSHOT_MAGIC || s->owner != this)
+		return false;
+
+	// Switch 1541 emulation and disk like LoadSnapshot()
+	if (emul_1541 != ThePrefs.Emul1541Proc || (emul_1541 && strcmp(ThePrefs.DrivePath[0], s->drive_path))) {
+		Prefs *prefs = new Prefs(ThePrefs);
+		if (emul_1541)
+			memcpy(prefs->DrivePath[0], s->drive_path, sizeof(s->drive_path));
+		prefs->Emul1541Proc = emul_1541;
+		NewPrefs(prefs);
+		ThePrefs = *prefs;
+		delete prefs;
+	}
+
+	TheVIC->SetState(&s->vic);
+	TheSID->SetState(&s->sid);
+	TheSID->SetBusState(&s->sid_bus);
+	TheCIA1->SetState(&s->cia1);
+	TheCIA2->SetState(&s->cia2);
+	TheCPU->SetState(&s->cpu);
+	TheCIA2->IECLines = s->cia2_iec_lines;
+#ifdef FRODO_SC
+	TheVIC->SetCycleState(&s->vic_cycle);
+	TheCIA1->SetCycleState(&s->cia1_cycle);
+	TheCIA2->SetCycleState(&s->cia2_cycle);
+	TheCPU->SetCycleState(&s->cpu_cycle);
+#endif
+	memcpy(Color, s->color, COLOR_RAM_SIZE);
+
+	if (emul_1541) {
+		memcpy(RAM1541, s->ram1541, DRIVE_RAM_SIZE);
+		TheCPU1541->SetState(&s->cpu1541);
+		TheJob1541->SetState(&s->job);
+		TheCPU1541->IECLines = s->drive_iec_lines;
+#ifdef FRODO_SC
+		TheCPU1541->SetCycleState(&s->cpu1541_cycle);
+#endif
+	}
+
+	// Copy back the RAM pages changed since the capture, they are
+	// different from every other arena now
+	sync_dirty_pages();
+	for (int i=0; i<0x100; i++)
+		if (page_epoch[i] > s->epoch) {
+			memcpy(RAM + (i << 8), s->ram + (i << 8), 0x100);
+			RAMDirty[i] = true;
+		}
+	return true;
+}
+
 void C64::Pause(void)
 {
 	/* No pause when the network is running */
@@ -701,7 +934,8 @@ bool C64::IsPaused()
 void C64::Resume(void)
 {
 	this->have_a_break = false;
-	TheSID->ResumeSound();
+	if (!this->warping)
+		TheSID->ResumeSound();
 	//SDL_FillRect(real_screen, NULL, 0);
 }
 
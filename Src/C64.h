@@ -22,6 +22,7 @@
 
 #include "Network.h"
 #include "Prefs.h"
+#include "FramePacer.h"
 
 /* Network connection type */
 enum
@@ -45,6 +46,34 @@ const size_t DRIVE_ROM_SIZE = 0x4000;
 // false: Frodo, true: FrodoSC
 extern bool IsFrodoSC;
 
+#ifdef FRODO_SC
+// Event sources for the cycle scheduler
+enum {
+	EVENT_CIA1,
+	EVENT_CIA2,
+	EVENT_VIA2,		// 1541 job IRQ
+	NUM_EVENTS
+};
+#endif
+
+#ifdef FRODO_PROFILE
+// Chips for the sampling profiler of the benchmark build
+enum {
+	PROF_CPU,
+	PROF_VIC,
+	PROF_CIA,
+	PROF_SID,
+	PROF_1541,
+	PROF_OTHER,
+	NUM_PROF
+};
+
+extern volatile int prof_chip;	// Chip currently being emulated
+#define PROFILE(chip) (prof_chip = (chip))
+#else
+#define PROFILE(chip)
+#endif
+
 class Prefs;
 class C64Display;
 class MOS6510;
@@ -57,6 +86,7 @@ class REU;
 class MOS6502_1541;
 class Job1541;
 class CmdPipe;
+class RewindBuffer;
 
 class C64 {
 public:
@@ -89,10 +119,14 @@ public:
 	bool LoadVICState(FILE *f);
 	bool LoadSIDState(FILE *f);
 	bool LoadCIAState(FILE *f);
+	size_t SnapshotSize(void);				// Size of an in-memory snapshot arena
+	void CaptureSnapshot(void *arena);		// Save state to memory (in VBlank)
+	bool RestoreSnapshot(const void *arena);	// Restore it (in VBlank)
 
 	uint8 *RAM, *Basic, *Kernal,
 		  *Char, *Color;		// C64
 	uint8 *RAM1541, *ROM1541;	// 1541
+	bool RAMDirty[0x100];		// RAM pages written since the last in-memory snapshot
 
 	C64Display *TheDisplay;
 
@@ -109,9 +143,17 @@ public:
 
 #ifdef FRODO_SC
 	uint32 CycleCounter;
+	uint32 EventClock;		// Cycle counter of the scheduler, only runs while the chips are clocked
+
+	void ScheduleEvent(int source, uint32 cycle);	// Clock source again at cycle
+	void CancelEvent(int source);					// Source has nothing to do
 #endif
 	bool IsPaused();
 
+	int SkipFrames(void);			// Frame skip for the VIC, higher while warping or too slow
+	void LoadActivity(void);		// Kernal IEC routine called (loading)
+	bool RunningAhead(void) { return this->running_ahead; }	// Emulating frames that are thrown away again
+
 	void quit()
 	{
 		this->quit_thyself = true;
@@ -127,6 +169,13 @@ private:
 	uint8 poll_joystick_hats(int port, bool *has_event);
 	uint8 poll_joystick_buttons(int port, uint8 *table, bool *has_event);
 	void thread_func(void);
+	void sync_dirty_pages(void);
+#ifdef FRODO_SC
+	void dispatch_events(void);
+	template<bool run_cpu, bool emul_1541> void emulate_frame(void);
+	void run_frame(void);
+	void run_ahead(void);
+#endif
 
 	bool thread_running;	// Emulation thread is running
 	bool quit_thyself;		// Emulation thread shall quit
@@ -135,15 +184,55 @@ private:
 	int joy_minx[2], joy_maxx[2], joy_miny[2], joy_maxy[2]; // For dynamic joystick calibration
 	uint8 joykey;			// Joystick keyboard emulation mask value
 
+	uint32 snap_epoch;			// Number of dirty page syncs for in-memory snapshots
+	uint32 page_epoch[0x100];	// Sync in which each RAM page last changed
+
 	uint8 orig_kernal_1d84,	// Original contents of kernal locations $1d84 and $1d85
 		  orig_kernal_1d85;	// (for undoing the Fast Reset patch)
 
+#ifdef FRODO_SC
+	uint32 event_cycle[NUM_EVENTS];	// Next cycle each event source needs attention
+	uint32 next_event_cycle;		// Earliest of event_cycle[]
+#endif
+
 public:
 	char server_hostname[255];
 	int server_port;
 	int network_connection_type;
 	Network *network;
 	int linecnt;
+	int frame_count;		// Number of VBlanks so far
+
+	char autostart_keys[64];	// Keys typed to LOAD and start AutostartFile
+	int autostart_pos;			// Next key to type
+
+	struct timeval bench_tv;	// Start of the benchmark period
+	int bench_frame;
+	uint32 bench_cycle;
+
+	FILE *golden_file;		// Golden frame hashes being checked or recorded
+
+	FramePacer pacer;			// Speed limit
+	uint32 net_last_update;		// Host time of the last network update
+	uint32 net_last_traffic_update;
+	bool net_throttled;			// Network traffic was throttled since the last meter update
+
+	bool warping;				// Running uncapped while loading
+	int load_idle_frames;		// Frames since the last drive activity
+
+	int auto_skip;				// Frame skip chosen by AutoSkip
+	uint32 skip_frames[2];		// Skipped and drawn frames measured so far
+	uint64 skip_ns[2];			// Their host time
+	uint64 speed_ns;			// Their nominal time
+	uint64 speed_start;			// Host time when the measurement started
+
+	RewindBuffer *rewind_buffer;	// Last frames to go back to, NULL if off
+	bool rewinding;				// Going back one frame per frame
+
+	int run_ahead_frames;		// Frames shown ahead of the input, 0 = off
+	bool running_ahead;			// Emulating these frames
+	bool ahead_drawn;			// The last of them was drawn
+	void *ahead_arena;			// Snapshot of the real timeline while running ahead
 
 	bool fake_key_sequence;
 	const char *fake_key_str;
@@ -154,6 +243,16 @@ public:
 	char save_game_name[256];
 
 	void network_vblank();
+	void setup_autostart(const char *path);
+	void autostart_vblank();
+	void start_bench();
+	void write_bench(const char *filename);
+	void golden_vblank();
+	void warp_vblank();
+	void autoskip_vblank(bool drawn, uint64 period);
+	void autoskip_reset();
+	void rewind_vblank();
+	void runahead_vblank();
 
 	void startFakeKeySequence(const char *str);
 	void run_fake_key_sequence();
@@ -161,4 +260,30 @@ public:
 };
 
 
+#ifdef FRODO_SC
+/*
+ *  Cycle scheduler: Event sources tell when they next have to be clocked,
+ *  the main loop only calls dispatch_events() when the earliest of these
+ *  cycles has been reached. All comparisons are done on the difference
+ *  to EventClock so that wraparound doesn't matter. Dispatching a source
+ *  too early is harmless, its handler just finds nothing to do.
+ *  EventClock is incremented before the events of a cycle are dispatched,
+ *  so code running outside of the chip emulation (VBlank, snapshots)
+ *  sees all events up to and including EventClock as done.
+ */
+
+inline void C64::ScheduleEvent(int source, uint32 cycle)
+{
+	event_cycle[source] = cycle;
+	if ((int32)(cycle - next_event_cycle) < 0)
+		next_event_cycle = cycle;
+}
+
+inline void C64::CancelEvent(int source)
+{
+	event_cycle[source] = EventClock + 0x7fffffff;
+}
+#endif
+
+
 #endif
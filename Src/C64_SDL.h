@@ -21,11 +21,33 @@
 
 #define C64_NETWORK_BROKER "c64-network.game-host.org"
 
+// Automatic warp: Draw every n-th frame, stop after n frames without loading
+const int WARP_SKIP_FRAMES = 10;
+const int WARP_HOLD_FRAMES = 25;
+
+// Automatic frame skip: Decide every n frames, skip more frames above HIGH
+// and fewer below LOW percent of the frame period, draw at least every
+// MAX-th frame
+const int AUTO_SKIP_PERIOD = 50;
+const int AUTO_SKIP_HIGH = 95;
+const int AUTO_SKIP_LOW = 80;
+const int AUTO_SKIP_MAX = 5;
+
 /* TODO: */
 extern char *network_server_connect;
 
 
-static struct timeval tv_start;
+#ifdef FRODO_PROFILE
+#include <signal.h>
+
+volatile int prof_chip = PROF_OTHER;
+static volatile uint32 prof_samples[NUM_PROF];
+
+static void prof_handler(int sig)
+{
+	prof_samples[prof_chip]++;
+}
+#endif
 
 /*
  *  Constructor, system-dependent things
@@ -39,6 +61,21 @@ void C64::c64_ctor1(void)
 	joy_maxx = joy_maxy = -32768;
 #endif
 	this->linecnt = 0;
+	this->frame_count = 0;
+
+	this->autostart_keys[0] = '\0';
+	this->autostart_pos = 0;
+	if (AutostartFile)
+		this->setup_autostart(AutostartFile);
+
+	this->golden_file = NULL;
+	if (GoldenFile) {
+		this->golden_file = fopen(GoldenFile, GoldenRecord ? "w" : "r");
+		if (!this->golden_file) {
+			fprintf(stderr, "Can't open golden file %s\n", GoldenFile);
+			exit(1);
+		}
+	}
 
 	this->fake_key_sequence = false;
 	this->fake_key_index = 0;
@@ -65,7 +102,23 @@ void C64::c64_ctor1(void)
 
 void C64::c64_ctor2(void)
 {
-	gettimeofday(&tv_start, NULL);
+	this->net_last_update = 0;
+	this->net_last_traffic_update = 0;
+	this->net_throttled = false;
+	this->warping = false;
+	this->load_idle_frames = WARP_HOLD_FRAMES;
+	this->auto_skip = 1;
+	this->autoskip_reset();
+
+	this->rewind_buffer = NULL;
+	if (ThePrefs.RewindMemory > 0)
+		this->rewind_buffer = new RewindBuffer(this, ThePrefs.RewindMemory * 1024);
+	this->rewinding = false;
+
+	this->run_ahead_frames = 0;
+	this->running_ahead = false;
+	this->ahead_drawn = false;
+	this->ahead_arena = NULL;
 }
 
 
@@ -75,6 +128,10 @@ void C64::c64_ctor2(void)
 
 void C64::c64_dtor(void)
 {
+	if (this->golden_file)
+		fclose(this->golden_file);
+	delete this->rewind_buffer;
+	free(this->ahead_arena);
 }
 
 
@@ -112,6 +169,390 @@ void C64::startFakeKeySequence(const char *str)
 	this->fake_key_sequence = true;
 }
 
+/*
+ *  Autostart: LOAD the program from drive 8 and start it with RUN or
+ *  SYS, depending on its load address. The keys go directly into the
+ *  kernal keyboard buffer, one line whenever the screen editor waits
+ *  for input, so this also works without GUI.
+ */
+
+void C64::setup_autostart(const char *path)
+{
+	const char *name = strrchr(path, '/');
+	char petscii_name[17];
+	int lo, hi, adr = 0x0801;
+	FILE *f;
+	int i;
+
+	name = name ? name + 1 : path;
+	for (i = 0; name[i] && i < 16; i++)
+		petscii_name[i] = toupper(name[i]);
+	petscii_name[i] = '\0';
+
+	f = fopen(path, "rb");
+	if (f) {
+		lo = fgetc(f);
+		hi = fgetc(f);
+		if (hi != EOF)
+			adr = lo | (hi << 8);
+		fclose(f);
+	} else
+		fprintf(stderr, "Can't open autostart program %s\n", path);
+
+	if (adr == 0x0801)
+		snprintf(this->autostart_keys, sizeof(this->autostart_keys),
+				"LOAD\"%s\",8,1\rRUN\r", petscii_name);
+	else
+		snprintf(this->autostart_keys, sizeof(this->autostart_keys),
+				"LOAD\"%s\",8,1\rSYS%d\r", petscii_name, adr);
+}
+
+void C64::autostart_vblank()
+{
+	MOS6510State state;
+	int n = 0;
+
+	if (this->autostart_keys[this->autostart_pos] == '\0')
+		return;
+
+	// Only when the screen editor loop at $e5cd waits for a key
+	TheCPU->GetState(&state);
+	if (state.pc < 0xe5cd || state.pc > 0xe5d4 || RAM[0xc6] != 0)
+		return;
+
+	// The keyboard buffer at $0277 holds up to 10 keys
+	while (n < 10 && this->autostart_keys[this->autostart_pos]) {
+		char c = this->autostart_keys[this->autostart_pos++];
+
+		RAM[0x277 + n++] = c;
+		if (c == '\r')
+			break;
+	}
+	RAM[0xc6] = n;
+	RAMDirty[0x00] = RAMDirty[0x02] = true;
+
+	// The program runs from now on
+	if (this->autostart_keys[this->autostart_pos] == '\0')
+		this->start_bench();
+}
+
+/*
+ *  Benchmark statistics: Speed since start_bench(), with the share of
+ *  each chip from a sampling profiler in FRODO_PROFILE builds. One
+ *  line of comma separated values is appended to the file.
+ */
+
+void C64::start_bench()
+{
+	gettimeofday(&this->bench_tv, NULL);
+	this->bench_frame = this->frame_count;
+#ifdef FRODO_SC
+	this->bench_cycle = CycleCounter;
+#endif
+#ifdef FRODO_PROFILE
+	for (int i = 0; i < NUM_PROF; i++)
+		prof_samples[i] = 0;
+#endif
+}
+
+void C64::write_bench(const char *filename)
+{
+	struct timeval now;
+	const char *name = AutostartFile ? AutostartFile : "-";
+	FILE *f;
+
+	gettimeofday(&now, NULL);
+	double secs = (now.tv_sec - this->bench_tv.tv_sec) +
+		(now.tv_usec - this->bench_tv.tv_usec) / 1000000.0;
+	int frames = this->frame_count - this->bench_frame;
+#ifdef FRODO_SC
+	double cycles = (uint32)(CycleCounter - this->bench_cycle);
+#else
+	double cycles = (double)frames * TOTAL_RASTERS * ThePrefs.NormalCycles;
+#endif
+	double ns_per_frame = frames ? secs * 1e9 / frames : 0;
+
+	f = fopen(filename, "a");
+	if (!f) {
+		fprintf(stderr, "Can't write benchmark results to %s\n", filename);
+		return;
+	}
+	fseek(f, 0, SEEK_END);
+	if (ftell(f) == 0)
+		fprintf(f, "program,frames,cycles,seconds,cycles_per_sec,frames_per_sec,ns_per_frame,"
+				"cpu_ns,vic_ns,cia_ns,sid_ns,1541_ns,other_ns\n");
+
+	fprintf(f, "%s,%d,%.0f,%.6f,%.0f,%.2f,%.0f", name, frames, cycles, secs,
+			secs > 0 ? cycles / secs : 0, secs > 0 ? frames / secs : 0, ns_per_frame);
+#ifdef FRODO_PROFILE
+	uint32 total = 0;
+	for (int i = 0; i < NUM_PROF; i++)
+		total += prof_samples[i];
+	for (int i = 0; i < NUM_PROF; i++)
+		fprintf(f, ",%.0f", total ? ns_per_frame * prof_samples[i] / total : 0);
+#else
+	// Per-chip times need a FRODO_PROFILE build
+	fprintf(f, ",,,,,,");
+#endif
+	fprintf(f, "\n");
+	fclose(f);
+}
+
+/*
+ *  Golden frames: Hash the bitmap and the sound output of each frame
+ *  and record the hashes, or compare them with a recorded run. A line
+ *  of the file holds the frame number, the bitmap and sound hashes and
+ *  an 8 bit hash of every bitmap row to find the first different
+ *  raster line.
+ */
+
+void C64::golden_vblank()
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	const int first_line = 0x10;	// Raster line of bitmap row 0 (FIRST_DISP_LINE)
+	const uint8 *p = TheDisplay->BitmapBase();
+	int xmod = TheDisplay->BitmapXMod();
+	uint32 vic_hash = 2166136261U;
+	uint32 sid_hash = TheSID->OutputHash();
+	char rows[DISPLAY_Y * 2 + 1];
+	char line[DISPLAY_Y * 2 + 64];
+	unsigned int golden_vic, golden_sid;
+	int frame, pos = 0;
+
+	if (!this->golden_file)
+		return;
+
+	for (int y = 0; y < DISPLAY_Y; y++, p += xmod) {
+		uint32 h = 2166136261U;
+
+		for (int x = 0; x < DISPLAY_X; x++)
+			h = (h ^ p[x]) * 16777619;
+		vic_hash = (vic_hash ^ h) * 16777619;
+
+		uint8 r = h ^ (h >> 8) ^ (h >> 16) ^ (h >> 24);
+		rows[y * 2] = hex_digits[r >> 4];
+		rows[y * 2 + 1] = hex_digits[r & 0x0f];
+	}
+	rows[DISPLAY_Y * 2] = '\0';
+
+	if (GoldenRecord) {
+		fprintf(this->golden_file, "%d %08x %08x %s\n", this->frame_count,
+				vic_hash, sid_hash, rows);
+		return;
+	}
+
+	// End of the recording?
+	if (!fgets(line, sizeof(line), this->golden_file) ||
+			sscanf(line, "%d %x %x %n", &frame, &golden_vic, &golden_sid, &pos) != 3) {
+		fprintf(stderr, "%s: %d frames match\n", GoldenFile, this->frame_count);
+		quit_thyself = true;
+		return;
+	}
+
+	if (frame != this->frame_count) {
+		fprintf(stderr, "%s: expected frame %d, found %d\n", GoldenFile,
+				this->frame_count, frame);
+		exit(1);
+	}
+
+	if (golden_vic != vic_hash) {
+		const char *golden_rows = line + pos;
+		int y;
+
+		for (y = 0; y < DISPLAY_Y; y++)
+			if (strncmp(golden_rows + y * 2, rows + y * 2, 2) != 0)
+				break;
+		if (y < DISPLAY_Y)
+			fprintf(stderr, "%s: frame %d differs, first at raster line %d ($%03x)\n",
+					GoldenFile, frame, first_line + y, first_line + y);
+		else
+			fprintf(stderr, "%s: frame %d differs\n", GoldenFile, frame);
+		exit(1);
+	}
+
+	if (golden_sid != sid_hash) {
+		fprintf(stderr, "%s: sound output differs in frame %d\n", GoldenFile, frame);
+		exit(1);
+	}
+}
+
+/*
+ *  Automatic warp mode: While a drive is busy, run uncapped with muted
+ *  sound and draw only every WARP_SKIP_FRAMES frame. The activity is
+ *  seen through the drive LEDs, the 1541 processor leaving its idle
+ *  loop and the kernal IEC traps (LoadActivity()). Warp ends after
+ *  WARP_HOLD_FRAMES frames without any of these.
+ */
+
+int C64::SkipFrames(void)
+{
+	if (this->warping)
+		return WARP_SKIP_FRAMES;
+	if (ThePrefs.AutoSkip && this->auto_skip > ThePrefs.SkipFrames)
+		return this->auto_skip;
+	return ThePrefs.SkipFrames;
+}
+
+void C64::LoadActivity(void)
+{
+	this->load_idle_frames = 0;
+}
+
+void C64::warp_vblank()
+{
+	bool warp;
+
+	// Keep the state while the GUI has paused the emulation
+	if (this->have_a_break)
+		return;
+
+	if (TheDisplay->DriveLEDOn() ||
+			(ThePrefs.Emul1541Proc && !TheCPU1541->Idle))
+		this->load_idle_frames = 0;
+	else if (this->load_idle_frames < WARP_HOLD_FRAMES)
+		this->load_idle_frames++;
+
+	// Network peers have to run in step, and rewinding goes back at the
+	// normal speed even if the restored frames load
+	warp = ThePrefs.AutoWarp && this->load_idle_frames < WARP_HOLD_FRAMES &&
+		!this->network && !this->rewinding;
+	if (warp == this->warping)
+		return;
+
+	this->warping = warp;
+	if (warp)
+		TheSID->PauseSound();
+	else {
+		// Rewinding keeps the sound off until it ends
+		if (!this->rewinding)
+			TheSID->ResumeSound();
+		this->pacer.Restart();
+	}
+}
+
+
+/*
+ *  Automatic frame skip (AutoSkip preference): The host time of each
+ *  frame is measured from the end of the last one, so it covers the
+ *  emulation, Display::Update() and, on a single core, the presenter
+ *  thread scaling and flipping the frame. Drawn and skipped frames are
+ *  averaged separately. Every AUTO_SKIP_PERIOD frames one more frame
+ *  is skipped if the average is above AUTO_SKIP_HIGH percent of the
+ *  frame period, and one less if the average with it drawn would stay
+ *  below AUTO_SKIP_LOW percent; in between nothing changes. Skipped
+ *  frames are still emulated completely, so the sound keeps going as
+ *  long as the emulation runs at 100%. The speed and the share of
+ *  drawn frames go to the speedometer.
+ */
+
+void C64::autoskip_reset()
+{
+	this->skip_frames[0] = this->skip_frames[1] = 0;
+	this->skip_ns[0] = this->skip_ns[1] = 0;
+	this->speed_ns = 0;
+	this->speed_start = FramePacer::Now();
+}
+
+void C64::autoskip_vblank(bool drawn, uint64 period)
+{
+	uint64 busy = this->pacer.Busy();
+	int skip = this->SkipFrames();
+
+	// Pacing just (re)started, nothing to measure
+	if (busy == 0) {
+		this->autoskip_reset();
+		return;
+	}
+
+	this->skip_frames[drawn]++;
+	this->skip_ns[drawn] += busy;
+	this->speed_ns += period;
+
+	uint32 frames = this->skip_frames[0] + this->skip_frames[1];
+	if (frames < (uint32)AUTO_SKIP_PERIOD)
+		return;
+
+	if (ThePrefs.ShowSpeed) {
+		uint64 elapsed = FramePacer::Now() - this->speed_start;
+		TheDisplay->Speedometer(elapsed ? (int)(this->speed_ns * 100 / elapsed) : 100, skip);
+	}
+
+	if (ThePrefs.AutoSkip) {
+		uint64 load = (this->skip_ns[0] + this->skip_ns[1]) / frames;
+
+		if (load * 100 > period * AUTO_SKIP_HIGH) {
+			if (skip < AUTO_SKIP_MAX)
+				this->auto_skip = skip + 1;
+		} else if (skip > ThePrefs.SkipFrames && this->skip_frames[0] && this->skip_frames[1]) {
+			// One of skip - 1 frames drawn instead of one of skip
+			uint64 drawn_ns = this->skip_ns[1] / this->skip_frames[1];
+			uint64 skipped_ns = this->skip_ns[0] / this->skip_frames[0];
+			uint64 next = (drawn_ns + (skip - 2) * skipped_ns) / (skip - 1);
+
+			if (next * 100 < period * AUTO_SKIP_LOW)
+				this->auto_skip = skip - 1;
+		}
+	}
+	this->autoskip_reset();
+}
+
+
+/*
+ *  Rewind: Save every frame in the rewind buffer. While the rewind key
+ *  is held, go back one frame per frame instead, with the sound off.
+ *  Saving and restoring happen at the same point of VBlank() so that
+ *  the emulation continues exactly as it did after the frame was saved.
+ */
+
+void C64::rewind_vblank()
+{
+	// Network peers have to run in step
+	if (!this->rewind_buffer || this->have_a_break || this->network)
+		return;
+
+	if (TheDisplay->rewind_held != this->rewinding) {
+		this->rewinding = TheDisplay->rewind_held;
+		// Warp has turned the sound off already
+		if (!this->warping) {
+			if (this->rewinding)
+				TheSID->PauseSound();
+			else
+				TheSID->ResumeSound();
+		}
+	}
+
+	if (this->rewinding)
+		this->rewind_buffer->Rewind();
+	else
+		this->rewind_buffer->Capture();
+}
+
+
+/*
+ *  Run-ahead: After each real frame, emulate the next RunAhead frames
+ *  with the same input, show the last of them and go back (run_ahead()).
+ *  A game that reacts to the input some frames late then seems to react
+ *  at once. Only the frames run ahead are shown, the sound only comes
+ *  from the real ones.
+ */
+
+void C64::runahead_vblank()
+{
+	int frames = ThePrefs.RunAhead;
+
+	// Network peers have to run in step, drive accesses can't be taken back
+	if (frames < 0 || this->have_a_break || this->network || this->warping ||
+			this->rewinding || this->load_idle_frames < WARP_HOLD_FRAMES)
+		frames = 0;
+
+#ifdef FRODO_SC
+	// The real frames are drawn into the VIC's scratch line
+	this->run_ahead_frames = frames;
+	TheVIC->SetHidden(frames > 0);
+#endif
+}
+
+
 /*
  *  Start main emulation thread
  */
@@ -132,12 +573,23 @@ void C64::Run(void)
 
 	quit_thyself = false;
 
+#ifdef FRODO_PROFILE
+	struct itimerval prof_timer = {{0, 1000}, {0, 1000}};
+	signal(SIGPROF, prof_handler);
+	setitimer(ITIMER_PROF, &prof_timer, NULL);
+#endif
+	start_bench();
+
 	thread_func();
+
+	if (BenchFile)
+		write_bench(BenchFile);
+	if (PacingStats)
+		this->pacer.PrintStats(stdout);
 }
 
 void C64::network_vblank()
 {
-        static uint32_t last_time_update;
 #if defined(GEKKO)
         Uint32 now = ticks_to_millisecs(gettime());
 #else
@@ -148,19 +600,19 @@ void C64::network_vblank()
         	Uint8 *master = this->TheDisplay->BitmapBase();
         	Network *remote = this->network;
 		uint8 *js;
-        	static bool has_throttled;
 
         	if (this->quit_thyself)
 		{
         		remote->Disconnect();
         		delete remote;
 			this->network = NULL;
-			TheC64->network_connection_type = NONE;
+			this->network_connection_type = NONE;
 
 			return;
 		}
 
-        	remote->Tick( now - last_time_update );
+        	remote->Tick( now - this->net_last_update );
+        	remote->MarkDirty(TheVIC->DirtyLines());
         	if (this->network_connection_type == MASTER) {
         		if (ThePrefs.JoystickSwap)
         			js = &TheCIA1->Joystick2;
@@ -204,7 +656,7 @@ void C64::network_vblank()
 		{
 			/* Skip this frame if the data rate is too high */
 			if (remote->ThrottleTraffic())
-				has_throttled = true;
+				this->net_throttled = true;
 			else {
 				remote->EncodeDisplay(master, remote->GetScreen());
 				remote->FlushSound();
@@ -219,18 +671,16 @@ void C64::network_vblank()
         		printf("Could not send update\n");
         	}
 
-		static uint32_t last_traffic_update;
-
-		if (last_time_update - last_traffic_update > 300)
+		if (this->net_last_update - this->net_last_traffic_update > 300)
 		{
 			TheDisplay->NetworkTrafficMeter(remote->GetKbps() / (8 * 1024.0),
-					has_throttled);
-			last_traffic_update = now;
-			has_throttled = false;
+					this->net_throttled);
+			this->net_last_traffic_update = now;
+			this->net_throttled = false;
         	}
         }
 
-        last_time_update = now;
+        this->net_last_update = now;
 }
 
 /*
@@ -240,26 +690,47 @@ void C64::network_vblank()
 void C64::VBlank(bool draw_frame)
 {
 	/* From Acorn port */
-	static uint32_t lastFrame;
-        uint32_t now;
         uint8 j1, j2;
         int joy_port_1 = 0;
 
+	PROFILE(PROF_OTHER);
+
+#ifdef FRODO_SC
+	// Keyboard, autostart and snapshots may change what an idle loop reads
+	TheCPU->WakeUp();
+#endif
+
+	// Frames run ahead keep the input of the real frame, and nothing
+	// outside of the emulation may see them
+	if (this->running_ahead) {
+		TheCIA1->CountTOD();
+		TheCIA2->CountTOD();
+		this->ahead_drawn = draw_frame;
+		this->frame_count++;
+		return;
+	}
+
         if (ThePrefs.JoystickSwap)
         	joy_port_1 = 1;
 
-	SDL_JoystickUpdate();
-	// Poll joysticks
-	j1 = poll_joystick(!joy_port_1);
-	j2 = poll_joystick(joy_port_1);
-
-	// Poll keyboard
-	TheDisplay->PollKeyboard(TheCIA1->KeyMatrix, TheCIA1->RevMatrix, &joykey);
-	if (TheDisplay->quit_requested)
-		quit_thyself = true;
+	if (HeadlessMode)
+		j1 = j2 = 0xff;
+	else {
+		// The presenter thread has updated the joysticks
+		TheDisplay->LockGui();
+		// Poll joysticks
+		j1 = poll_joystick(!joy_port_1);
+		j2 = poll_joystick(joy_port_1);
+
+		// Poll keyboard
+		TheDisplay->PollKeyboard(TheCIA1->KeyMatrix, TheCIA1->RevMatrix, &joykey);
+		if (TheDisplay->quit_requested)
+			quit_thyself = true;
+	}
 
 	if (this->fake_key_sequence)
 		this->run_fake_key_sequence();
+	this->autostart_vblank();
 
 	/* Keyboard joystick input */
 	if (ThePrefs.JoystickSwap)
@@ -295,74 +766,193 @@ void C64::VBlank(bool draw_frame)
 	TheCIA1->CountTOD();
 	TheCIA2->CountTOD();
 
-	// Update window if needed
-	if (draw_frame && this->network_connection_type != CLIENT) {
-		TheDisplay->Update();
-	}
+	this->golden_vblank();
+
+	// Run N frames then exit
+	this->frame_count++;
+	if (FramesToRun && this->frame_count >= FramesToRun)
+		quit_thyself = true;
+
+	/* Headless mode leaves the frame in the bitmap, runs unthrottled */
+	if (HeadlessMode)
+		return;
+
+	bool drawn = draw_frame;
+
+	this->warp_vblank();
+	this->rewind_vblank();
+	this->runahead_vblank();
+
+	// The frame run ahead is shown instead, from this frame on
+	if (this->run_ahead_frames)
+		draw_frame = false;
 
 	this->network_vblank();
 
 	Gui::gui->runLogic();
+	TheDisplay->UnlockGui();
+
+	// Hand the frame to the presenter thread if needed. This comes after
+	// network_vblank() which sends the bitmap to the peer.
+	if (draw_frame && this->network_connection_type != CLIENT)
+		TheDisplay->Update();
 
 	//if (this->quit_thyself)
 	//	ThePrefs.Save(ThePrefs.PrefsPath);
 #if defined(GEKKO)
 	if (this->quit_thyself && Network::networking_started == true)
 		SYS_ResetSystem(SYS_RETURNTOMENU, 0, 0);
-        now = ticks_to_millisecs(gettime());
-#else
-        now = SDL_GetTicks();
 #endif
 
-        if ( (now - lastFrame) < ThePrefs.MsPerFrame) {
-        	usleep( (ThePrefs.MsPerFrame - (now - lastFrame)) * 1000);
-        }
-        lastFrame = now;
+	uint64 period = ThePrefs.MsPerFrame * (uint64)1000000;
+	int fill;
+
+	// Run at the rate the sound is played, slower when the sound
+	// buffer fills up and faster when it drains (up to 5%)
+	if (ThePrefs.AudioSync && (fill = TheSID->BufferFill()) >= 0) {
+		period = 1000000000 / SCREEN_FREQ;
+		period += (int64)period * (fill - 50) / 1000;
+	}
+	if (!this->warping) {
+		this->autoskip_vblank(drawn, period);
+		this->pacer.Wait(period);
+	}
 }
 
+#ifdef FRODO_SC
 /*
- * The emulation's main loop
+ * Emulate cycles until the end of the current frame. There is one
+ * instance per configuration so that the preferences, pause and
+ * network role are not looked at in every cycle: run_cpu is false
+ * while paused and for network clients (they only show the screen
+ * of the master), emul_1541 selects the processor-level 1541.
  */
 
-void C64::thread_func(void)
+template<bool run_cpu, bool emul_1541>
+void C64::emulate_frame(void)
 {
-	int linecnt = 0;
+	int frame = this->frame_count;
 
-#ifdef FRODO_SC
-	while (!quit_thyself) {
+	for (;;) {
+		bool line_done;
 
 		// The order of calls is important here
-		if (TheVIC->EmulateCycle())
+		PROFILE(PROF_VIC);
+		if ((line_done = TheVIC->EmulateCycle())) {
+			PROFILE(PROF_SID);
 			TheSID->EmulateLine();
-		/* No need to emulate anything for the client */
-		if (!this->have_a_break && this->network_connection_type != CLIENT) {
-			TheCIA1->CheckIRQs();
-			TheCIA2->CheckIRQs();
-			TheCIA1->EmulateCycle();
-			TheCIA2->EmulateCycle();
+		}
+		if (run_cpu) {
+			EventClock++;
+			if ((int32)(EventClock - next_event_cycle) >= 0) {
+				PROFILE(PROF_CIA);
+				dispatch_events();
+			}
+			PROFILE(PROF_CPU);
 			TheCPU->EmulateCycle();
 
-			if (ThePrefs.Emul1541Proc) {
-				TheCPU1541->CountVIATimers(1);
-				if (!TheCPU1541->Idle)
-					TheCPU1541->EmulateCycle();
+			if (emul_1541 && !TheCPU1541->Idle) {
+				PROFILE(PROF_1541);
+				TheCPU1541->EmulateCycle();
 			}
 		}
 		CycleCounter++;
+
+		// VBlank() may have changed the configuration
+		if (line_done && this->frame_count != frame)
+			return;
+	}
+}
+
+
+/*
+ * Emulate one frame in the configuration selected by the preferences
+ */
+
+void C64::run_frame(void)
+{
+	if (this->have_a_break || this->network_connection_type == CLIENT)
+		emulate_frame<false, false>();
+	else if (ThePrefs.Emul1541Proc)
+		emulate_frame<true, true>();
+	else
+		emulate_frame<true, false>();
+}
+
+
+/*
+ * Run ahead of the real frame that just ended (see runahead_vblank()).
+ * The real state is saved in memory, the following frames are emulated
+ * with only the last one drawn into the bitmap, and the real state is
+ * restored again.
+ */
+
+void C64::run_ahead(void)
+{
+	int frame = this->frame_count;
+	int load_idle = this->load_idle_frames;
+
+	if (this->ahead_arena == NULL)
+		this->ahead_arena = calloc(1, SnapshotSize());
+	CaptureSnapshot(this->ahead_arena);
+
+	TheSID->HoldRenderer(true);
+	this->running_ahead = true;
+	for (int i=1; i<=this->run_ahead_frames && !quit_thyself; i++) {
+		TheVIC->SetHidden(i < this->run_ahead_frames);
+		run_frame();
+	}
+	this->running_ahead = false;
+	TheSID->HoldRenderer(false);
+
+	// A frame that waited for a drive access (see CPUC64_SC.cpp) is not shown
+	bool show = this->ahead_drawn && this->load_idle_frames >= WARP_HOLD_FRAMES;
+
+	// Loading that was only predicted must not start warp
+	RestoreSnapshot(this->ahead_arena);
+	TheVIC->SetHidden(true);
+	this->frame_count = frame;
+	this->load_idle_frames = load_idle;
+
+	if (show)
+		TheDisplay->Update();
+}
+#endif
+
+/*
+ * The emulation's main loop
+ */
+
+void C64::thread_func(void)
+{
+#ifdef FRODO_SC
+	while (!quit_thyself) {
+		run_frame();
+		if (this->run_ahead_frames)
+			run_ahead();
+	}
 #else
+	int linecnt = 0;
+
 	while (!quit_thyself) {
 
 		// The order of calls is important here
+		PROFILE(PROF_VIC);
 		int cycles = TheVIC->EmulateLine();
+		PROFILE(PROF_SID);
 		TheSID->EmulateLine();
 #if !PRECISE_CIA_CYCLES
+		PROFILE(PROF_CIA);
 		TheCIA1->EmulateLine(ThePrefs.CIACycles);
 		TheCIA2->EmulateLine(ThePrefs.CIACycles);
 #endif
+		PROFILE(PROF_CPU);
 
 		if (ThePrefs.Emul1541Proc) {
 			int cycles_1541 = ThePrefs.FloppyCycles;
+			PROFILE(PROF_1541);
 			TheCPU1541->CountVIATimers(cycles_1541);
+			PROFILE(PROF_CPU);
 
 			if (!TheCPU1541->Idle) {
 				// 1541 processor active, alternately execute
@@ -378,7 +968,7 @@ void C64::thread_func(void)
 		} else
 			// 1541 processor disabled, only emulate 6510
 			TheCPU->EmulateLine(cycles);
-#endif
 		linecnt++;
 	}
+#endif
 }
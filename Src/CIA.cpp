@@ -53,9 +53,9 @@
  *  Constructors
  */
 
-MOS6526::MOS6526(MOS6510 *CPU) : the_cpu(CPU) {}
-MOS6526_1::MOS6526_1(MOS6510 *CPU, MOS6569 *VIC) : MOS6526(CPU), the_vic(VIC) {}
-MOS6526_2::MOS6526_2(MOS6510 *CPU, MOS6569 *VIC, MOS6502_1541 *CPU1541) : MOS6526(CPU), the_vic(VIC), the_cpu_1541(CPU1541) {}
+MOS6526::MOS6526(C64 *c64, MOS6510 *CPU) : the_c64(c64), the_cpu(CPU) {}
+MOS6526_1::MOS6526_1(C64 *c64, MOS6510 *CPU, MOS6569 *VIC) : MOS6526(c64, CPU), the_vic(VIC) {}
+MOS6526_2::MOS6526_2(C64 *c64, MOS6510 *CPU, MOS6569 *VIC, MOS6502_1541 *CPU1541) : MOS6526(c64, CPU), the_vic(VIC), the_cpu_1541(CPU1541) {}
 
 
 /*
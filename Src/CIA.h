@@ -24,22 +24,27 @@
 #include "Prefs.h"
 
 
+class C64;
 class MOS6510;
 class MOS6502_1541;
 class MOS6569;
 struct MOS6526State;
+struct MOS6526CycleState;
 
 
 class MOS6526 {
 public:
-	MOS6526(MOS6510 *CPU);
+	MOS6526(C64 *c64, MOS6510 *CPU);
 
 	void Reset(void);
 	void GetState(MOS6526State *cs);
 	void SetState(MOS6526State *cs);
 #ifdef FRODO_SC
+	void GetCycleState(MOS6526CycleState *cs);
+	void SetCycleState(MOS6526CycleState *cs);
 	void CheckIRQs(void);
 	void EmulateCycle(void);
+	void EmulateEvent(void);	// Called by the C64 cycle scheduler
 #else
 	void EmulateLine(int cycles);
 #endif
@@ -47,6 +52,15 @@ public:
 	virtual void TriggerInterrupt(int bit)=0;
 
 protected:
+#ifdef FRODO_SC
+	void count_timers(uint32 until);
+	void update_timers(void);
+	void schedule_event(void);
+
+	int event_source;	// EVENT_CIA1/EVENT_CIA2
+	uint32 timer_cycle;	// First cycle not yet accounted for in ta/tb
+#endif
+	C64 *the_c64;		// Pointer to C64 object
 	MOS6510 *the_cpu;	// Pointer to 6510
 
 	uint8 pra, prb, ddra, ddrb;
@@ -79,7 +93,7 @@ protected:
 
 class MOS6526_1 : public MOS6526 {
 public:
-	MOS6526_1(MOS6510 *CPU, MOS6569 *VIC);
+	MOS6526_1(C64 *c64, MOS6510 *CPU, MOS6569 *VIC);
 
 	void Reset(void);
 	uint8 ReadRegister(uint16 adr);
@@ -103,7 +117,7 @@ private:
 
 class MOS6526_2 : public MOS6526{
 public:
-	MOS6526_2(MOS6510 *CPU, MOS6569 *VIC, MOS6502_1541 *CPU1541);
+	MOS6526_2(C64 *c64, MOS6510 *CPU, MOS6569 *VIC, MOS6502_1541 *CPU1541);
 
 	void Reset(void);
 	uint8 ReadRegister(uint16 adr);
@@ -146,6 +160,18 @@ struct MOS6526State {
 	uint8 int_mask;		// Enabled interrupts
 };
 
+#ifdef FRODO_SC
+// Frodo SC state that is not part of MOS6526State (and of the snapshot files)
+struct MOS6526CycleState {
+	int tod_divider;
+	bool tod_halt;
+	bool ta_irq_next_cycle, tb_irq_next_cycle;
+	bool has_new_cra, has_new_crb;
+	char ta_state, tb_state;
+	uint8 new_cra, new_crb;
+};
+#endif
+
 
 /*
  *  Emulate CIA for one cycle/raster line
@@ -25,6 +25,15 @@
  *  - The Emulate() function is called for every emulated Phi2
  *    clock cycle. It counts down the timers and triggers
  *    interrupts if necessary.
+ *  - The C64 cycle scheduler only calls EmulateEvent() (and thus
+ *    Emulate()) in cycles where the timer state machines do more
+ *    than count down: state changes, pending interrupts, delayed
+ *    CR writes and timer underflows. In the cycles in between, the
+ *    timers are known to be counting without underflowing, so
+ *    ta/tb are only brought up to date (count_timers()) when the
+ *    CIA is clocked again or a register is accessed. A CIA with
+ *    both timers stopped is not clocked at all until CRA/CRB are
+ *    written again.
  *  - The TOD clocks are counted by CountTOD() during the VBlank, so
  *    the input frequency is 50Hz
  *  - The fields KeyMatrix and RevMatrix contain one bit for each
@@ -44,6 +53,7 @@
 #include "sysdeps.h"
 
 #include "CIA.h"
+#include "C64.h"
 #include "CPUC64.h"
 #include "CPU1541.h"
 #include "VIC.h"
@@ -66,9 +76,9 @@ enum {
  *  Constructors
  */
 
-MOS6526::MOS6526(MOS6510 *CPU) : the_cpu(CPU) { has_new_cra = false; has_new_crb = false; }
-MOS6526_1::MOS6526_1(MOS6510 *CPU, MOS6569 *VIC) : MOS6526(CPU), the_vic(VIC) {}
-MOS6526_2::MOS6526_2(MOS6510 *CPU, MOS6569 *VIC, MOS6502_1541 *CPU1541) : MOS6526(CPU), the_vic(VIC), the_cpu_1541(CPU1541) {}
+MOS6526::MOS6526(C64 *c64, MOS6510 *CPU) : the_c64(c64), the_cpu(CPU) { has_new_cra = false; has_new_crb = false; }
+MOS6526_1::MOS6526_1(C64 *c64, MOS6510 *CPU, MOS6569 *VIC) : MOS6526(c64, CPU), the_vic(VIC) { event_source = EVENT_CIA1; }
+MOS6526_2::MOS6526_2(C64 *c64, MOS6510 *CPU, MOS6569 *VIC, MOS6502_1541 *CPU1541) : MOS6526(c64, CPU), the_vic(VIC), the_cpu_1541(CPU1541) { event_source = EVENT_CIA2; }
 
 
 /*
@@ -94,6 +104,8 @@ void MOS6526::Reset(void)
 
 	ta_irq_next_cycle = tb_irq_next_cycle = false;
 	ta_state = tb_state = T_STOP;
+	timer_cycle = the_c64->EventClock + 1;
+	schedule_event();
 }
 
 void MOS6526_1::Reset(void)
@@ -126,6 +138,8 @@ void MOS6526_2::Reset(void)
 
 void MOS6526::GetState(MOS6526State *cs)
 {
+	update_timers();
+
 	cs->pra = pra;
 	cs->prb = prb;
 	cs->ddra = ddra;
@@ -195,6 +209,42 @@ void MOS6526::SetState(MOS6526State *cs)
 
 	ta_state = (cra & 1) ? T_COUNT : T_STOP;
 	tb_state = (crb & 1) ? T_COUNT : T_STOP;
+	timer_cycle = the_c64->EventClock + 1;
+	schedule_event();
+}
+
+
+/*
+ *  Get/restore the state not held by MOS6526State
+ */
+
+void MOS6526::GetCycleState(MOS6526CycleState *cs)
+{
+	cs->tod_divider = tod_divider;
+	cs->tod_halt = tod_halt;
+	cs->ta_irq_next_cycle = ta_irq_next_cycle;
+	cs->tb_irq_next_cycle = tb_irq_next_cycle;
+	cs->has_new_cra = has_new_cra;
+	cs->has_new_crb = has_new_crb;
+	cs->ta_state = ta_state;
+	cs->tb_state = tb_state;
+	cs->new_cra = new_cra;
+	cs->new_crb = new_crb;
+}
+
+void MOS6526::SetCycleState(MOS6526CycleState *cs)
+{
+	tod_divider = cs->tod_divider;
+	tod_halt = cs->tod_halt;
+	ta_irq_next_cycle = cs->ta_irq_next_cycle;
+	tb_irq_next_cycle = cs->tb_irq_next_cycle;
+	has_new_cra = cs->has_new_cra;
+	has_new_crb = cs->has_new_crb;
+	ta_state = cs->ta_state;
+	tb_state = cs->tb_state;
+	new_cra = cs->new_cra;
+	new_crb = cs->new_crb;
+	schedule_event();
 }
 
 
@@ -231,10 +281,10 @@ uint8 MOS6526_1::ReadRegister(uint16 adr)
 		}
 		case 0x02: return ddra;
 		case 0x03: return ddrb;
-		case 0x04: return ta;
-		case 0x05: return ta >> 8;
-		case 0x06: return tb;
-		case 0x07: return tb >> 8;
+		case 0x04: update_timers(); return ta;
+		case 0x05: update_timers(); return ta >> 8;
+		case 0x06: update_timers(); return tb;
+		case 0x07: update_timers(); return tb >> 8;
 		case 0x08: tod_halt = false; return tod_10ths;
 		case 0x09: return tod_sec;
 		case 0x0a: return tod_min;
@@ -266,10 +316,10 @@ uint8 MOS6526_2::ReadRegister(uint16 adr)
 		case 0x01: return prb | ~ddrb;
 		case 0x02: return ddra;
 		case 0x03: return ddrb;
-		case 0x04: return ta;
-		case 0x05: return ta >> 8;
-		case 0x06: return tb;
-		case 0x07: return tb >> 8;
+		case 0x04: update_timers(); return ta;
+		case 0x05: update_timers(); return ta >> 8;
+		case 0x06: update_timers(); return tb;
+		case 0x07: update_timers(); return tb >> 8;
 		case 0x08: tod_halt = false; return tod_10ths;
 		case 0x09: return tod_sec;
 		case 0x0a: return tod_min;
@@ -302,6 +352,8 @@ inline void MOS6526_1::check_lp(void)
 
 void MOS6526_1::WriteRegister(uint16 adr, uint8 byte)
 {
+	update_timers();
+
 	switch (adr) {
 		case 0x0: pra = byte; break;
 		case 0x1:
@@ -373,6 +425,7 @@ void MOS6526_1::WriteRegister(uint16 adr, uint8 byte)
 			has_new_cra = true;		// Delay write by 1 cycle
 			new_cra = byte;
 			ta_cnt_phi2 = ((byte & 0x20) == 0x00);
+			schedule_event();
 			break;
 
 		case 0xf:
@@ -380,6 +433,7 @@ void MOS6526_1::WriteRegister(uint16 adr, uint8 byte)
 			new_crb = byte;
 			tb_cnt_phi2 = ((byte & 0x60) == 0x00);
 			tb_cnt_ta = ((byte & 0x60) == 0x40);
+			schedule_event();
 			break;
 	}
 }
@@ -391,6 +445,8 @@ void MOS6526_1::WriteRegister(uint16 adr, uint8 byte)
 
 void MOS6526_2::WriteRegister(uint16 adr, uint8 byte)
 {
+	update_timers();
+
 	switch (adr) {
 		case 0x0:{
 			pra = byte;
@@ -473,6 +529,7 @@ void MOS6526_2::WriteRegister(uint16 adr, uint8 byte)
 			has_new_cra = true;		// Delay write by 1 cycle
 			new_cra = byte;
 			ta_cnt_phi2 = ((byte & 0x20) == 0x00);
+			schedule_event();
 			break;
 
 		case 0xf:
@@ -480,6 +537,7 @@ void MOS6526_2::WriteRegister(uint16 adr, uint8 byte)
 			new_crb = byte;
 			tb_cnt_phi2 = ((byte & 0x60) == 0x00);
 			tb_cnt_ta = ((byte & 0x60) == 0x40);
+			schedule_event();
 			break;
 	}
 }
@@ -680,6 +738,88 @@ tb_idle:
 }
 
 
+/*
+ *  Count down the timers for the cycles from timer_cycle up to (but
+ *  not including) until. The scheduler makes sure that these are plain
+ *  counting cycles without underflows.
+ */
+
+inline void MOS6526::count_timers(uint32 until)
+{
+	int32 cycles = until - timer_cycle;
+
+	if (cycles > 0) {
+		if (ta_state == T_COUNT && ta_cnt_phi2)
+			ta -= cycles;
+		if (tb_state == T_COUNT && tb_cnt_phi2)
+			tb -= cycles;
+		timer_cycle = until;
+	}
+}
+
+
+/*
+ *  Bring timers up to date before a register access
+ */
+
+void MOS6526::update_timers(void)
+{
+	count_timers(the_c64->EventClock + 1);
+}
+
+
+/*
+ *  Called by the C64 cycle scheduler
+ */
+
+void MOS6526::EmulateEvent(void)
+{
+	count_timers(the_c64->EventClock);
+	CheckIRQs();
+	EmulateCycle();
+	timer_cycle = the_c64->EventClock + 1;
+	schedule_event();
+}
+
+
+/*
+ *  Tell the C64 cycle scheduler when to clock us again: In the next
+ *  cycle if the timer state machines are doing anything else than
+ *  counting down, at the next underflow if they are counting, and
+ *  not at all if both timers are stopped
+ */
+
+void MOS6526::schedule_event(void)
+{
+	uint32 now = the_c64->EventClock;
+
+	if ((ta_state != T_STOP && ta_state != T_COUNT) || (tb_state != T_STOP && tb_state != T_COUNT)
+	 || ta_irq_next_cycle || tb_irq_next_cycle || has_new_cra || has_new_crb) {
+		the_c64->ScheduleEvent(event_source, now + 1);
+		return;
+	}
+
+	// Timer B counting underflows of timer A only changes in timer A underflow cycles
+	uint32 delay = 0x10000;
+	bool counting = false;
+	if (ta_state == T_COUNT && ta_cnt_phi2) {
+		delay = ta ? ta : 1;	// The timer underflows in the cycle it is decremented from 1 (or found 0)
+		counting = true;
+	}
+	if (tb_state == T_COUNT && tb_cnt_phi2) {
+		uint32 tb_delay = tb ? tb : 1;
+		if (tb_delay < delay)
+			delay = tb_delay;
+		counting = true;
+	}
+
+	if (counting)
+		the_c64->ScheduleEvent(event_source, now + delay);
+	else
+		the_c64->CancelEvent(event_source);
+}
+
+
 /*
  *  Count CIA TOD clock (called during VBlank)
  */
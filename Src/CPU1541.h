@@ -37,6 +37,22 @@
 #define PRECISE_CPU_CYCLES 0
 #endif
 
+// Set this to 1 to dispatch opcodes through a table of labels (needs GCC's
+// computed goto) instead of the switch statement
+#ifndef THREADED_DISPATCH
+#if defined(__GNUC__)
+#define THREADED_DISPATCH 1
+#else
+#define THREADED_DISPATCH 0
+#endif
+#endif
+
+// Set this to 1 to pre-decode the drive ROM and execute ROM instructions
+// that only access RAM and ROM in their first cycle (Frodo SC)
+#ifndef DECODE_ROM
+#define DECODE_ROM 1
+#endif
+
 
 // Interrupt types
 enum {
@@ -51,6 +67,7 @@ class C64;
 class Job1541;
 class C64Display;
 struct MOS6502State;
+struct MOS6502CycleState;
 
 
 // 6502 emulation (1541)
@@ -60,6 +77,7 @@ public:
 
 #ifdef FRODO_SC
 	void EmulateCycle(void);			// Emulate one clock cycle
+	void DecodeROM(void);				// ROM contents have been set up
 #else
 	int EmulateLine(int cycles_left);	// Emulate until cycles_left underflows
 #endif
@@ -69,7 +87,13 @@ public:
 	void SetState(MOS6502State *s);
 	uint8 ExtReadByte(uint16 adr);
 	void ExtWriteByte(uint16 adr, uint8 byte);
+#ifdef FRODO_SC
+	void GetCycleState(MOS6502CycleState *s);
+	void SetCycleState(MOS6502CycleState *s);
+	void EmulateEvent(void);			// VIA 2 timer 1 underflow scheduled
+#else
 	void CountVIATimers(int cycles);
+#endif
 	void NewATNState(void);
 	void IECInterrupt(void);
 	void TriggerJobIRQ(void);
@@ -98,6 +122,15 @@ private:
 	void do_adc(uint8 byte);
 	void do_sbc(uint8 byte);
 
+#ifdef FRODO_SC
+	void count_via_timers(uint32 cycles);
+	void sync_via_timers(void);
+	void schedule_via_event(void);
+
+	bool decode_ok(uint8 op, uint16 operand);
+	int exec_decoded(void);
+#endif
+
 	uint8 *ram;				// Pointer to main RAM
 	uint8 *rom;				// Pointer to ROM
 	C64 *the_c64;			// Pointer to C64 object
@@ -125,6 +158,20 @@ private:
 	uint16 ar, ar2;			// Address registers
 	uint8 rdbuf;			// Data buffer for RMW instructions
 	uint8 ddr, pr;			// Processor port
+
+	// Pre-decoded ROM, one entry per address. Instructions with the
+	// fast flag set are executed by exec_decoded() in their first cycle,
+	// the rest of their cycles only count down busy_cycles.
+	struct DecodedOp {
+		uint8 op;			// Opcode
+		bool fast;			// Static operand is RAM/ROM, or checked when executed
+		uint16 operand;		// The two bytes following the opcode
+	};
+	DecodedOp rom_dec[0x4000];
+	int busy_cycles;		// Cycles left of an instruction executed at once
+
+	uint32 via_cycle;		// EventClock up to which the VIA timers are counted
+	uint32 via_event;		// EventClock of the next VIA 2 timer 1 underflow
 #else
 	int borrowed_cycles;	// Borrowed cycles from next line
 #endif
@@ -197,6 +244,18 @@ struct MOS6502State {
 	uint8 via2_ier;
 };
 
+#ifdef FRODO_SC
+// Frodo SC state that is not part of MOS6502State (and of the snapshot
+// files): the instruction in progress and the cycle timing
+struct MOS6502CycleState {
+	uint8 state, op;	// Current state and opcode
+	uint16 ar, ar2;		// Address registers
+	uint8 rdbuf;		// Data buffer for RMW instructions
+	int busy_cycles;	// Cycles left of an instruction executed at once
+	uint32 irq_age;		// Cycles since IRQ was triggered
+};
+#endif
+
 
 
 /*
@@ -220,6 +279,7 @@ inline void MOS6502_1541::TriggerJobIRQ(void)
 #endif
 
 
+#ifndef FRODO_SC
 /*
  *  Count VIA timers
  */
@@ -256,6 +316,7 @@ inline void MOS6502_1541::CountVIATimers(int cycles)
 			via2_ifr |= 0x20;
 	}
 }
+#endif
 
 
 /*
@@ -58,6 +58,18 @@
  *  - The 1541 6502 emulation also includes a very simple VIA
  *    emulation (enough to make the IEC bus and GCR loading work).
  *    It's too small to move it to a source file of its own.
+ *  - The VIA timers are not clocked in every cycle. They are brought
+ *    up to date from via_cycle when a VIA register is accessed, and
+ *    the underflow of VIA 2 timer 1 that triggers the job IRQ is an
+ *    event of the C64 cycle scheduler (EVENT_VIA2).
+ *  - With DECODE_ROM, the ROM is pre-decoded (opcode and operand per
+ *    address) when C64::PatchKernal() has set it up. A ROM instruction
+ *    whose accesses all go to RAM or ROM is executed at once in its
+ *    first cycle and the remaining cycles only count down busy_cycles.
+ *    Nothing outside the 6502 can tell the difference: I/O accesses,
+ *    RAM location $7c (written by IECInterrupt()) and branches that
+ *    would delay an IRQ that may come in meanwhile are left to the
+ *    state machine.
  *
  * Incompatibilities:
  * ------------------
@@ -99,6 +111,10 @@ MOS6502_1541::MOS6502_1541(C64 *c64, Job1541 *job, C64Display *disp, uint8 *Ram,
 	via2_sr = 0;
 
 	first_irq_cycle = 0;
+	memset(rom_dec, 0, sizeof(rom_dec));
+	busy_cycles = 0;
+	via_cycle = 0;
+	via_event = 0;
 	Idle = false;
 }
 
@@ -120,6 +136,8 @@ void MOS6502_1541::AsyncReset(void)
 
 void MOS6502_1541::GetState(MOS6502State *s)
 {
+	sync_via_timers();
+
 	s->a = a;
 	s->x = x;
 	s->y = y;
@@ -155,6 +173,8 @@ void MOS6502_1541::GetState(MOS6502State *s)
 	s->via2_sr = via2_sr;
 	s->via2_acr = via2_acr; s->via2_pcr = via2_pcr;
 	s->via2_ifr = via2_ifr; s->via2_ier = via2_ier;
+
+	s->instruction_complete = (state == 0 && busy_cycles == 0);
 }
 
 
@@ -177,6 +197,7 @@ void MOS6502_1541::SetState(MOS6502State *s)
 
 	pc = s->pc;
 	sp = s->sp & 0xff;
+	busy_cycles = 0;
 
 	interrupt.intr[INT_VIA1IRQ] = s->intr[INT_VIA1IRQ];
 	interrupt.intr[INT_VIA2IRQ] = s->intr[INT_VIA2IRQ];
@@ -199,6 +220,125 @@ void MOS6502_1541::SetState(MOS6502State *s)
 	via2_sr = s->via2_sr;
 	via2_acr = s->via2_acr; via2_pcr = s->via2_pcr;
 	via2_ifr = s->via2_ifr; via2_ier = s->via2_ier;
+
+	via_cycle = the_c64->EventClock;
+	schedule_via_event();
+}
+
+
+/*
+ *  Get/restore the state not held by MOS6502State (call after GetState()
+ *  and SetState())
+ */
+
+void MOS6502_1541::GetCycleState(MOS6502CycleState *s)
+{
+	s->state = state;
+	s->op = op;
+	s->ar = ar;
+	s->ar2 = ar2;
+	s->rdbuf = rdbuf;
+	s->busy_cycles = busy_cycles;
+	s->irq_age = the_c64->CycleCounter - first_irq_cycle;
+}
+
+void MOS6502_1541::SetCycleState(MOS6502CycleState *s)
+{
+	state = s->state;
+	op = s->op;
+	ar = s->ar;
+	ar2 = s->ar2;
+	rdbuf = s->rdbuf;
+	busy_cycles = s->busy_cycles;
+	first_irq_cycle = the_c64->CycleCounter - s->irq_age;
+}
+
+
+/*
+ *  Count VIA timers over the given number of cycles (at once)
+ */
+
+inline void MOS6502_1541::count_via_timers(uint32 cycles)
+{
+	uint32 period;
+
+	if (cycles > via1_t1c) {
+		// Reload from latch in free-run mode, else wrap around
+		period = (via1_acr & 0x40 ? via1_t1l : 0xffff) + 1;
+		via1_t1c = period - 1 - (cycles - via1_t1c - 1) % period;
+		via1_ifr |= 0x40;
+	} else
+		via1_t1c -= cycles;
+
+	if (!(via1_acr & 0x20)) {	// Only count in one-shot mode
+		if (cycles > via1_t2c) {
+			via1_t2c = 0xffff - (cycles - via1_t2c - 1) % 0x10000;
+			via1_ifr |= 0x20;
+		} else
+			via1_t2c -= cycles;
+	}
+
+	if (cycles > via2_t1c) {
+		period = (via2_acr & 0x40 ? via2_t1l : 0xffff) + 1;
+		via2_t1c = period - 1 - (cycles - via2_t1c - 1) % period;
+		via2_ifr |= 0x40;
+		if (via2_ier & 0x40)	// EVENT_VIA2 makes this the cycle of the underflow
+			TriggerJobIRQ();
+	} else
+		via2_t1c -= cycles;
+
+	if (!(via2_acr & 0x20)) {
+		if (cycles > via2_t2c) {
+			via2_t2c = 0xffff - (cycles - via2_t2c - 1) % 0x10000;
+			via2_ifr |= 0x20;
+		} else
+			via2_t2c -= cycles;
+	}
+}
+
+
+/*
+ *  Bring the VIA timers up to the current cycle
+ */
+
+inline void MOS6502_1541::sync_via_timers(void)
+{
+	uint32 cycles = the_c64->EventClock - via_cycle;
+
+	if (cycles) {
+		count_via_timers(cycles);
+		via_cycle = the_c64->EventClock;
+	}
+}
+
+
+/*
+ *  Tell the C64 cycle scheduler when VIA 2 timer 1 underflows next
+ *  (only needed while it triggers the job IRQ)
+ */
+
+void MOS6502_1541::schedule_via_event(void)
+{
+	if (via2_ier & 0x40)
+		via_event = via_cycle + via2_t1c + 1;
+	else
+		via_event = via_cycle + 0x7fffffff;
+
+	if (via2_ier & 0x40)
+		the_c64->ScheduleEvent(EVENT_VIA2, via_event);
+	else
+		the_c64->CancelEvent(EVENT_VIA2);
+}
+
+
+/*
+ *  VIA 2 timer 1 underflow event
+ */
+
+void MOS6502_1541::EmulateEvent(void)
+{
+	sync_via_timers();
+	schedule_via_event();
 }
 
 
@@ -208,6 +348,8 @@ void MOS6502_1541::SetState(MOS6502State *s)
 
 inline uint8 MOS6502_1541::read_byte_io(uint16 adr)
 {
+	sync_via_timers();
+
 	if ((adr & 0xfc00) == 0x1800)	// VIA 1
 		switch (adr & 0xf) {
 			case 0:
@@ -329,6 +471,8 @@ inline uint16 MOS6502_1541::read_word(uint16 adr)
 
 void MOS6502_1541::write_byte_io(uint16 adr, uint8 byte)
 {
+	sync_via_timers();
+
 	if ((adr & 0xfc00) == 0x1800)		// VIA 1
 		switch (adr & 0xf) {
 			case 0:
@@ -422,6 +566,7 @@ void MOS6502_1541::write_byte_io(uint16 adr, uint8 byte)
 				via2_t1l = (via2_t1l & 0xff) | (byte << 8);
 				via2_ifr &= 0xbf;
 				via2_t1c = via2_t1l;
+				schedule_via_event();
 				break;
 			case 7:
 				via2_t1l = (via2_t1l & 0xff) | (byte << 8);
@@ -451,6 +596,7 @@ void MOS6502_1541::write_byte_io(uint16 adr, uint8 byte)
 					via2_ier |= byte & 0x7f;
 				else
 					via2_ier &= ~byte;
+				schedule_via_event();
 				break;
 		}
 }
@@ -570,12 +716,15 @@ void MOS6502_1541::Reset(void)
 	// IEC lines and VIA registers
 	IECLines = 0xc0;
 
+	sync_via_timers();
+
 	via1_pra = via1_ddra = via1_prb = via1_ddrb = 0;
 	via1_acr = via1_pcr = 0;
 	via1_ifr = via1_ier = 0;
 	via2_pra = via2_ddra = via2_prb = via2_ddrb = 0;
 	via2_acr = via2_pcr = 0;
 	via2_ifr = via2_ier = 0;
+	schedule_via_event();
 
 	// Clear all interrupt lines
 	interrupt.intr_any = 0;
@@ -583,6 +732,7 @@ void MOS6502_1541::Reset(void)
 	// Read reset vector
 	pc = read_word(0xfffc);
 	state = 0;
+	busy_cycles = 0;
 
 	// Wake up 1541
 	Idle = false;
@@ -604,6 +754,421 @@ void MOS6502_1541::illegal_op(uint8 op, uint16 at)
 }
 
 
+/*
+ *  Pre-decode the ROM (called by C64::PatchKernal())
+ */
+
+// RAM and ROM accesses have no side effects and don't depend on the
+// cycle they happen in, except for $7c which IECInterrupt() sets
+#define dec_read_ok(adr) ((adr) >= 0xc000 || ((adr) < 0x1000 && ((adr) & 0x7ff) != 0x7c))
+#define dec_write_ok(adr) ((adr) < 0x1000 && ((adr) & 0x7ff) != 0x7c)
+
+// Dummy reads of indexed modes go to the page of the base address
+#define dec_page_ok(adr) ((adr) >= 0xc000 || (adr) < 0x1000)
+
+void MOS6502_1541::DecodeROM(void)
+{
+#if DECODE_ROM
+	for (int i=0; i<0x4000; i++) {
+		DecodedOp &d = rom_dec[i];
+		d.op = rom[i];
+		if (i < 0x3ffe) {	// The operand of the last two would be in RAM
+			d.operand = rom[i+1] | (rom[i+2] << 8);
+			d.fast = decode_ok(d.op, d.operand);
+		} else {
+			d.operand = 0;
+			d.fast = false;
+		}
+	}
+#endif
+}
+
+// Check the operand addresses that are known before execution
+bool MOS6502_1541::decode_ok(uint8 op, uint16 operand)
+{
+	uint8 zp = operand & 0xff;
+
+	switch (ModeTab[op]) {
+		case A_ZERO: case M_ZERO:
+			return zp != 0x7c;
+
+		case A_ABS:
+			if (OpTab[op] == O_JMP_I)
+				return dec_read_ok(operand) && dec_read_ok((operand & 0xff00) | ((operand + 1) & 0xff));
+			else if (OpTab[op] == O_STA || OpTab[op] == O_STX || OpTab[op] == O_STY)
+				return dec_write_ok(operand);
+			else
+				return dec_read_ok(operand);
+		case M_ABS:
+			return dec_write_ok(operand);
+
+		case A_ABSX: case A_ABSY: case AE_ABSX: case AE_ABSY:
+		case M_ABSX: case M_ABSY:
+			return dec_page_ok(operand);
+
+		case A_INDY: case AE_INDY: case M_INDY:
+			return zp != 0x7b && zp != 0x7c;
+
+		case O_EXT:
+			return false;
+
+		default:	// Checked by exec_decoded(), or no memory operand
+			return true;
+	}
+}
+
+
+/*
+ *  Execute the pre-decoded instruction at pc at once, return the number
+ *  of cycles it takes or 0 if it has to go through the state machine
+ *  (which must then find everything unchanged)
+ */
+
+// Set N and Z flags according to byte
+#define set_nz(x) (z_flag = n_flag = (x))
+
+// Read RAM/ROM
+#define dec_read(adr) ((adr) >= 0xc000 ? rom[(adr) & 0x3fff] : ram[(adr) & 0x7ff])
+
+// Addressing modes for reading operands (-> data), with cycles
+#define R_IMM data = d.operand; pc += 2; cycles = 2;
+#define R_ZP data = ram[d.operand & 0xff]; pc += 2; cycles = 3;
+#define R_ZPX \
+	adr = (d.operand + x) & 0xff; \
+	if (adr == 0x7c) return 0; \
+	data = ram[adr]; pc += 2; cycles = 4;
+#define R_ZPY \
+	adr = (d.operand + y) & 0xff; \
+	if (adr == 0x7c) return 0; \
+	data = ram[adr]; pc += 2; cycles = 4;
+#define R_ABS data = dec_read(d.operand); pc += 3; cycles = 4;
+#define R_ABS_IDX(reg) \
+	adr = d.operand + reg; \
+	if (!dec_read_ok(adr)) return 0; \
+	data = dec_read(adr); pc += 3; \
+	cycles = ((adr ^ d.operand) & 0xff00) ? 5 : 4;
+#define R_ABSX R_ABS_IDX(x)
+#define R_ABSY R_ABS_IDX(y)
+#define R_INDX \
+	tmp = d.operand + x; \
+	if (tmp == 0x7b || tmp == 0x7c) return 0; \
+	adr = ram[tmp] | (ram[(uint8)(tmp + 1)] << 8); \
+	if (!dec_read_ok(adr)) return 0; \
+	data = dec_read(adr); pc += 2; cycles = 6;
+#define R_INDY \
+	tmp = d.operand; \
+	base = ram[tmp] | (ram[(uint8)(tmp + 1)] << 8); \
+	adr = base + y; \
+	if (!dec_page_ok(base) || !dec_read_ok(adr)) return 0; \
+	data = dec_read(adr); pc += 2; \
+	cycles = ((adr ^ base) & 0xff00) ? 6 : 5;
+
+// Addressing modes for writing (-> adr), with cycles
+#define W_ZP adr = d.operand & 0xff; pc += 2; cycles = 3;
+#define W_ZPX \
+	adr = (d.operand + x) & 0xff; \
+	if (adr == 0x7c) return 0; \
+	pc += 2; cycles = 4;
+#define W_ZPY \
+	adr = (d.operand + y) & 0xff; \
+	if (adr == 0x7c) return 0; \
+	pc += 2; cycles = 4;
+#define W_ABS adr = d.operand; pc += 3; cycles = 4;
+#define W_ABS_IDX(reg) \
+	adr = d.operand + reg; \
+	if (!dec_write_ok(adr)) return 0; \
+	pc += 3; cycles = 5;
+#define W_ABSX W_ABS_IDX(x)
+#define W_ABSY W_ABS_IDX(y)
+#define W_INDX \
+	tmp = d.operand + x; \
+	if (tmp == 0x7b || tmp == 0x7c) return 0; \
+	adr = ram[tmp] | (ram[(uint8)(tmp + 1)] << 8); \
+	if (!dec_write_ok(adr)) return 0; \
+	pc += 2; cycles = 6;
+#define W_INDY \
+	tmp = d.operand; \
+	base = ram[tmp] | (ram[(uint8)(tmp + 1)] << 8); \
+	adr = base + y; \
+	if (!dec_page_ok(base) || !dec_write_ok(adr)) return 0; \
+	pc += 2; cycles = 6;
+
+// Addressing modes for read-modify-write (-> adr, data), with cycles
+#define RMW_ZP W_ZP data = ram[adr]; cycles = 5;
+#define RMW_ZPX W_ZPX data = ram[adr]; cycles = 6;
+#define RMW_ABS W_ABS data = ram[adr & 0x7ff]; cycles = 6;
+#define RMW_ABSX W_ABSX data = ram[adr & 0x7ff]; cycles = 7;
+
+// All addressing modes of a read instruction
+#define READ_OPS(o_imm, o_zp, o_zpx, o_abs, o_absx, o_absy, o_indx, o_indy, exec) \
+		case o_imm: R_IMM exec; break; \
+		case o_zp: R_ZP exec; break; \
+		case o_zpx: R_ZPX exec; break; \
+		case o_abs: R_ABS exec; break; \
+		case o_absx: R_ABSX exec; break; \
+		case o_absy: R_ABSY exec; break; \
+		case o_indx: R_INDX exec; break; \
+		case o_indy: R_INDY exec; break;
+
+// All addressing modes of a shift/rotate/increment instruction
+#define RMW_OPS(o_zp, o_zpx, o_abs, o_absx, exec) \
+		case o_zp: RMW_ZP exec; break; \
+		case o_zpx: RMW_ZPX exec; break; \
+		case o_abs: RMW_ABS exec; break; \
+		case o_absx: RMW_ABSX exec; break;
+
+// Compare
+#define dec_cmp(reg) \
+	tmp16 = reg - data; \
+	set_nz(tmp16); \
+	c_flag = tmp16 < 0x100;
+
+// Processor flags for pushing
+#define dec_flags(b_flag) \
+	(0x20 | (n_flag & 0x80) | (v_flag ? 0x40 : 0) | (b_flag ? 0x10 : 0) | (d_flag ? 0x08 : 0) \
+	 | (i_flag ? 0x04 : 0) | (z_flag ? 0 : 0x02) | (c_flag ? 0x01 : 0))
+
+// Branch, a taken one without page crossing delays the IRQ in its last
+// cycle, so it must not be executed early if the IRQ may come in between
+#define dec_branch(flag) \
+	if (flag) { \
+		adr = pc + 2 + (int8)d.operand; \
+		if ((adr ^ (pc + 2)) & 0xff00) \
+			cycles = 4; \
+		else { \
+			if (!interrupt.intr[INT_VIA2IRQ] && (uint32)(via_event - the_c64->EventClock - 1) < 2) \
+				return 0; \
+			first_irq_cycle++; \
+			cycles = 3; \
+		} \
+		pc = adr; \
+	} else { \
+		pc += 2; \
+		cycles = 2; \
+	} \
+	break;
+
+int MOS6502_1541::exec_decoded(void)
+{
+	const DecodedOp &d = rom_dec[pc & 0x3fff];
+	uint16 adr, base, tmp16;
+	uint8 data, tmp;
+	int cycles;
+
+	switch (d.op) {
+
+		// Load group
+		READ_OPS(0xa9, 0xa5, 0xb5, 0xad, 0xbd, 0xb9, 0xa1, 0xb1, set_nz(a = data))
+		case 0xa2: R_IMM set_nz(x = data); break;
+		case 0xa6: R_ZP set_nz(x = data); break;
+		case 0xb6: R_ZPY set_nz(x = data); break;
+		case 0xae: R_ABS set_nz(x = data); break;
+		case 0xbe: R_ABSY set_nz(x = data); break;
+		case 0xa0: R_IMM set_nz(y = data); break;
+		case 0xa4: R_ZP set_nz(y = data); break;
+		case 0xb4: R_ZPX set_nz(y = data); break;
+		case 0xac: R_ABS set_nz(y = data); break;
+		case 0xbc: R_ABSX set_nz(y = data); break;
+
+		// Store group
+		case 0x85: W_ZP ram[adr] = a; break;
+		case 0x95: W_ZPX ram[adr] = a; break;
+		case 0x8d: W_ABS ram[adr & 0x7ff] = a; break;
+		case 0x9d: W_ABSX ram[adr & 0x7ff] = a; break;
+		case 0x99: W_ABSY ram[adr & 0x7ff] = a; break;
+		case 0x81: W_INDX ram[adr & 0x7ff] = a; break;
+		case 0x91: W_INDY ram[adr & 0x7ff] = a; break;
+		case 0x86: W_ZP ram[adr] = x; break;
+		case 0x96: W_ZPY ram[adr] = x; break;
+		case 0x8e: W_ABS ram[adr & 0x7ff] = x; break;
+		case 0x84: W_ZP ram[adr] = y; break;
+		case 0x94: W_ZPX ram[adr] = y; break;
+		case 0x8c: W_ABS ram[adr & 0x7ff] = y; break;
+
+		// Transfer group
+		case 0xaa: pc++; cycles = 2; set_nz(x = a); break;
+		case 0x8a: pc++; cycles = 2; set_nz(a = x); break;
+		case 0xa8: pc++; cycles = 2; set_nz(y = a); break;
+		case 0x98: pc++; cycles = 2; set_nz(a = y); break;
+		case 0xba: pc++; cycles = 2; set_nz(x = sp); break;
+		case 0x9a: pc++; cycles = 2; sp = x; break;
+
+		// Arithmetic group
+		READ_OPS(0x69, 0x65, 0x75, 0x6d, 0x7d, 0x79, 0x61, 0x71, do_adc(data))
+		READ_OPS(0xe9, 0xe5, 0xf5, 0xed, 0xfd, 0xf9, 0xe1, 0xf1, do_sbc(data))
+
+		// Increment/decrement group
+		case 0xe8: pc++; cycles = 2; set_nz(++x); break;
+		case 0xca: pc++; cycles = 2; set_nz(--x); break;
+		case 0xc8: pc++; cycles = 2; set_nz(++y); break;
+		case 0x88: pc++; cycles = 2; set_nz(--y); break;
+		RMW_OPS(0xe6, 0xf6, 0xee, 0xfe, ram[adr & 0x7ff] = set_nz(data + 1))
+		RMW_OPS(0xc6, 0xd6, 0xce, 0xde, ram[adr & 0x7ff] = set_nz(data - 1))
+
+		// Logic group
+		READ_OPS(0x29, 0x25, 0x35, 0x2d, 0x3d, 0x39, 0x21, 0x31, set_nz(a &= data))
+		READ_OPS(0x09, 0x05, 0x15, 0x0d, 0x1d, 0x19, 0x01, 0x11, set_nz(a |= data))
+		READ_OPS(0x49, 0x45, 0x55, 0x4d, 0x5d, 0x59, 0x41, 0x51, set_nz(a ^= data))
+
+		// Compare group
+		READ_OPS(0xc9, 0xc5, 0xd5, 0xcd, 0xdd, 0xd9, 0xc1, 0xd1, dec_cmp(a))
+		case 0xe0: R_IMM dec_cmp(x); break;
+		case 0xe4: R_ZP dec_cmp(x); break;
+		case 0xec: R_ABS dec_cmp(x); break;
+		case 0xc0: R_IMM dec_cmp(y); break;
+		case 0xc4: R_ZP dec_cmp(y); break;
+		case 0xcc: R_ABS dec_cmp(y); break;
+
+		// Bit-test group
+		case 0x24: R_ZP z_flag = a & data; n_flag = data; v_flag = data & 0x40; break;
+		case 0x2c: R_ABS z_flag = a & data; n_flag = data; v_flag = data & 0x40; break;
+
+		// Shift/rotate group
+		RMW_OPS(0x06, 0x16, 0x0e, 0x1e, c_flag = data & 0x80; ram[adr & 0x7ff] = set_nz(data << 1))
+		RMW_OPS(0x46, 0x56, 0x4e, 0x5e, c_flag = data & 0x01; ram[adr & 0x7ff] = set_nz(data >> 1))
+		RMW_OPS(0x26, 0x36, 0x2e, 0x3e, ram[adr & 0x7ff] = set_nz(c_flag ? (data << 1) | 0x01 : data << 1); c_flag = data & 0x80)
+		RMW_OPS(0x66, 0x76, 0x6e, 0x7e, ram[adr & 0x7ff] = set_nz(c_flag ? (data >> 1) | 0x80 : data >> 1); c_flag = data & 0x01)
+		case 0x0a:
+			pc++; cycles = 2;
+			c_flag = a & 0x80;
+			set_nz(a <<= 1);
+			break;
+		case 0x4a:
+			pc++; cycles = 2;
+			c_flag = a & 0x01;
+			set_nz(a >>= 1);
+			break;
+		case 0x2a:
+			pc++; cycles = 2;
+			data = a & 0x80;
+			set_nz(a = c_flag ? (a << 1) | 0x01 : a << 1);
+			c_flag = data;
+			break;
+		case 0x6a:
+			pc++; cycles = 2;
+			data = a & 0x01;
+			set_nz(a = c_flag ? (a >> 1) | 0x80 : a >> 1);
+			c_flag = data;
+			break;
+
+		// Stack group
+		case 0x48:
+			pc++; cycles = 3;
+			ram[0x100 | sp--] = a;
+			break;
+		case 0x68:
+			pc++; cycles = 4;
+			set_nz(a = ram[0x100 | ++sp]);
+			break;
+		case 0x08:
+			pc++; cycles = 3;
+			ram[0x100 | sp--] = dec_flags(true);
+			break;
+		case 0x28:
+			pc++; cycles = 4;
+			data = ram[0x100 | ++sp];
+			n_flag = data;
+			v_flag = data & 0x40;
+			d_flag = data & 0x08;
+			i_flag = data & 0x04;
+			z_flag = !(data & 0x02);
+			c_flag = data & 0x01;
+			break;
+
+		// Jump/branch group
+		case 0x4c:
+			pc = d.operand; cycles = 3;
+			break;
+		case 0x6c:
+			pc = dec_read(d.operand) | (dec_read((d.operand & 0xff00) | ((d.operand + 1) & 0xff)) << 8);
+			cycles = 5;
+			break;
+		case 0x20:
+			pc += 2; cycles = 6;
+			ram[0x100 | sp--] = pc >> 8;
+			ram[0x100 | sp--] = pc;
+			pc = d.operand;
+			break;
+		case 0x60:
+			cycles = 6;
+			pc = ram[0x100 | ++sp];
+			pc |= ram[0x100 | ++sp] << 8;
+			pc++;
+			break;
+		case 0x40:
+			cycles = 6;
+			data = ram[0x100 | ++sp];
+			n_flag = data;
+			v_flag = data & 0x40;
+			d_flag = data & 0x08;
+			i_flag = data & 0x04;
+			z_flag = !(data & 0x02);
+			c_flag = data & 0x01;
+			pc = ram[0x100 | ++sp];
+			pc |= ram[0x100 | ++sp] << 8;
+			break;
+		case 0x00:
+			pc += 2; cycles = 7;
+			ram[0x100 | sp--] = pc >> 8;
+			ram[0x100 | sp--] = pc;
+			ram[0x100 | sp--] = dec_flags(true);
+			i_flag = true;
+			pc = rom[0x3ffe] | (rom[0x3fff] << 8);
+			break;
+
+		case 0xb0: dec_branch(c_flag)
+		case 0x90: dec_branch(!c_flag)
+		case 0xf0: dec_branch(!z_flag)
+		case 0xd0: dec_branch(z_flag)
+		case 0x70: dec_branch((via2_pcr & 0x0e) == 0x0e ? 1 : v_flag)	// GCR byte ready flag
+		case 0x50: dec_branch(!((via2_pcr & 0x0e) == 0x0e) ? 0 : v_flag)
+		case 0x30: dec_branch(n_flag & 0x80)
+		case 0x10: dec_branch(!(n_flag & 0x80))
+
+		// Flag group
+		case 0x38: pc++; cycles = 2; c_flag = true; break;
+		case 0x18: pc++; cycles = 2; c_flag = false; break;
+		case 0xf8: pc++; cycles = 2; d_flag = true; break;
+		case 0xd8: pc++; cycles = 2; d_flag = false; break;
+		case 0x78: pc++; cycles = 2; i_flag = true; break;
+		case 0x58: pc++; cycles = 2; i_flag = false; break;
+		case 0xb8: pc++; cycles = 2; v_flag = false; break;
+
+		// NOP
+		case 0xea: pc++; cycles = 2; break;
+
+		default:	// Undocumented opcodes
+			return 0;
+	}
+	return cycles;
+}
+
+#undef set_nz
+#undef R_IMM
+#undef R_ZP
+#undef R_ZPX
+#undef R_ZPY
+#undef R_ABS
+#undef R_ABS_IDX
+#undef R_ABSX
+#undef R_ABSY
+#undef R_INDX
+#undef R_INDY
+#undef W_ZP
+#undef W_ZPX
+#undef W_ZPY
+#undef W_ABS
+#undef W_ABS_IDX
+#undef W_ABSX
+#undef W_ABSY
+#undef W_INDX
+#undef W_INDY
+#undef RMW_ZP
+#undef RMW_ZPX
+#undef RMW_ABS
+#undef RMW_ABSX
+
+
 /*
  *  Emulate one 6502 clock cycle
  */
@@ -620,6 +1185,12 @@ void MOS6502_1541::EmulateCycle(void)
 {
 	uint8 data, tmp;
 
+	// Rest of an instruction executed at once?
+	if (busy_cycles) {
+		busy_cycles--;
+		return;
+	}
+
 	// Any pending interrupts in state 0 (opcode fetch)?
 	if (!state && interrupt.intr_any) {
 		if (interrupt.intr[INT_RESET])
@@ -628,6 +1199,17 @@ void MOS6502_1541::EmulateCycle(void)
 			state = 0x0008;
 	}
 
+#if DECODE_ROM
+	// Pre-decoded ROM instruction?
+	if (!state && pc >= 0xc000 && rom_dec[pc & 0x3fff].fast) {
+		int cycles = exec_decoded();
+		if (cycles) {
+			busy_cycles = cycles - 1;
+			return;
+		}
+	}
+#endif
+
 #define IS_CPU_1541
 #include "CPU_emulcycle.h"
 
@@ -42,6 +42,17 @@
  *    decoding. The read_zp() and write_zp() functions allow
  *    faster access to the zero page, the pop_byte() and
  *    push_byte() macros for the stack.
+ *  - RAM and ROM pages are decoded through per-configuration
+ *    page tables (mem_read_tab/mem_write_tab), I/O pages go
+ *    the slow way
+ *  - With DECODE_CACHE, every executed instruction is kept
+ *    decoded (opcode label and operand) in ram_dec/rom_dec and
+ *    dispatched from there the next time. Writes through
+ *    write_byte() reset the RAM entries that could contain the
+ *    written byte. ROM entries are reset when the Kernal is
+ *    patched (DecodeROM()). Zero page and
+ *    stack are not cached, so write_zp() and push_byte() don't
+ *    have to check anything
  *  - If a write occurs to addresses 0 or 1, new_config is
  *    called to check whether the memory configuration has
  *    changed
@@ -110,7 +121,112 @@ MOS6510::MOS6510(C64 *c64, uint8 *Ram, uint8 *Basic, uint8 *Kernal, uint8 *Char,
 	i_flag = true;
 	dfff_byte = 0x55;
 	borrowed_cycles = 0;
+
+	init_mem_tabs();
+	read_tab = mem_read_tab[7];
+	write_tab = mem_write_tab[7];
+
+#if DECODE_CACHE
+	dec_base = ram_dec;
+	dec_miss = NULL;
+	memset(code_page, 0, sizeof(code_page));
+#endif
+}
+
+
+/*
+ *  Set up the page tables for all 8 memory configurations
+ */
+
+void MOS6510::init_mem_tabs(void)
+{
+	for (int config=0; config<8; config++) {
+		bool basic = (config & 3) == 3;
+		bool kernal = config & 2;
+		bool chr = (config & 3) && !(config & 4);
+		bool io = (config & 3) && (config & 4);
+		uint8 **rd = mem_read_tab[config];
+		uint8 **wr = mem_write_tab[config];
+
+		for (int page=0; page<0x100; page++) {
+			uint8 *r = ram + (page << 8);
+			uint8 *w = ram + (page << 8);
+
+			if (page >= 0xa0 && page < 0xc0 && basic)
+				r = basic_rom + ((page - 0xa0) << 8);
+			else if (page >= 0xd0 && page < 0xe0) {
+				if (io)
+					r = w = NULL;
+				else if (chr)
+					r = char_rom + ((page - 0xd0) << 8);
+			} else if (page >= 0xe0 && kernal)
+				r = kernal_rom + ((page - 0xe0) << 8);
+
+			// $ff00 triggers REU DMA
+			if (page == 0xff)
+				w = NULL;
+
+			rd[page] = r;
+			wr[page] = w;
+		}
+	}
+}
+
+
+#if DECODE_CACHE
+/*
+ *  Set up the decoded instruction tables, "miss" is the label in
+ *  EmulateLine() that decodes an instruction
+ */
+
+void MOS6510::init_decode_cache(void *miss)
+{
+	dec_miss = miss;
+	for (int i=0; i<0x6000; i++)
+		rom_dec[i].handler = miss;
+	flush_decode_cache();
+}
+
+
+/*
+ *  Forget all decoded ROM instructions, they are decoded again when
+ *  they are executed (called by C64::PatchKernal())
+ */
+
+void MOS6510::DecodeROM(void)
+{
+	if (dec_miss == NULL)	// Not set up yet
+		return;
+	for (int i=0; i<0x6000; i++)
+		rom_dec[i].handler = dec_miss;
+}
+
+
+/*
+ *  Forget all decoded RAM instructions (RAM was changed behind our back)
+ */
+
+void MOS6510::flush_decode_cache(void)
+{
+	for (int i=0; i<0x10000; i++)
+		ram_dec[i].handler = dec_miss;
+	memset(code_page, 0, sizeof(code_page));
+}
+
+
+/*
+ *  RAM byte at adr was written, forget the instructions containing it
+ */
+
+inline void MOS6510::invalidate_code(uint16 adr)
+{
+	if (code_page[adr >> 8]) {
+		ram_dec[adr].handler = dec_miss;
+		ram_dec[(uint16)(adr - 1)].handler = dec_miss;
+		ram_dec[(uint16)(adr - 2)].handler = dec_miss;
+	}
 }
+#endif
 
 
 /*
@@ -146,6 +262,9 @@ void MOS6510::new_config(void)
 	kernal_in = port & 2;
 	char_in = (port & 3) && !(port & 4);
 	io_in = (port & 3) && (port & 4);
+
+	read_tab = mem_read_tab[port & 7];
+	write_tab = mem_write_tab[port & 7];
 }
 
 
@@ -217,8 +336,10 @@ inline uint8 MOS6510::read_byte_io(uint16 adr)
 
 uint8 MOS6510::read_byte(uint16 adr)
 {
-	if (adr < 0xa000)
-		return ram[adr];
+	uint8 *page = read_tab[adr >> 8];
+
+	if (page != NULL)
+		return page[adr & 0xff];
 	else
 		return read_byte_io(adr);
 }
@@ -256,43 +377,12 @@ uint8 MOS6510::read_emulator_id(uint16 adr)
 
 inline uint16 MOS6510::read_word(uint16 adr)
 {
-	switch (adr >> 12) {
-		case 0x0:
-		case 0x1:
-		case 0x2:
-		case 0x3:
-		case 0x4:
-		case 0x5:
-		case 0x6:
-		case 0x7:
-		case 0x8:
-		case 0x9:
-			return *(uint16*)&ram[adr];
-			break;
-		case 0xa:
-		case 0xb:
-			if (basic_in)
-				return *(uint16*)&basic_rom[adr & 0x1fff];
-			else
-				return *(uint16*)&ram[adr];
-		case 0xc:
-			return *(uint16*)&ram[adr];
-		case 0xd:
-			if (io_in)
-				return read_byte(adr) | (read_byte(adr+1) << 8);
-			else if (char_in)
-				return *(uint16*)&char_rom[adr & 0x0fff];
-			else
-				return *(uint16*)&ram[adr];
-		case 0xe:
-		case 0xf:
-			if (kernal_in)
-				return *(uint16*)&kernal_rom[adr & 0x1fff];
-			else
-				return *(uint16*)&ram[adr];
-		default:	// Can't happen
-			return 0;
-	}
+	uint8 *page = read_tab[adr >> 8];
+
+	if (page != NULL && (adr & 0xff) != 0xff)
+		return *(uint16*)&page[adr & 0xff];
+	else
+		return read_byte(adr) | (read_byte(adr+1) << 8);
 }
 
 #else
@@ -313,6 +403,9 @@ void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 {
 	if (adr >= 0xe000) {
 		ram[adr] = byte;
+#if DECODE_CACHE
+		invalidate_code(adr);
+#endif
 		if (adr == 0xff00)
 			TheREU->FF00Trigger();
 	} else if (io_in)
@@ -347,8 +440,12 @@ void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 					TheREU->WriteRegister(adr & 0x0f, byte);
 				return;
 		}
-	else
-		ram[adr] = byte;	
+	else {
+		ram[adr] = byte;
+#if DECODE_CACHE
+		invalidate_code(adr);
+#endif
+	}
 }
 
 
@@ -358,8 +455,13 @@ void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 
 inline void MOS6510::write_byte(uint16 adr, uint8 byte)
 {
-	if (adr < 0xd000) {
-		ram[adr] = byte;
+	uint8 *page = write_tab[adr >> 8];
+
+	if (page != NULL) {
+		page[adr & 0xff] = byte;
+#if DECODE_CACHE
+		invalidate_code(adr);
+#endif
 		if (adr < 2)
 			new_config();
 	} else
@@ -414,18 +516,23 @@ uint8 MOS6510::ExtReadByte(uint16 adr)
 {
 	// Save old memory configuration
 	bool bi = basic_in, ki = kernal_in, ci = char_in, ii = io_in;
+	uint8 **rt = read_tab, **wt = write_tab;
 
-	// Set new configuration
+	// Set new configuration, decoded like the processor port in
+	// new_config() (the Char ROM is only seen where I/O is not)
 	basic_in = (ExtConfig & 3) == 3;
 	kernal_in = ExtConfig & 2;
-	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
+	char_in = (ExtConfig & 3) && !(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	read_tab = mem_read_tab[ExtConfig & 7];
+	write_tab = mem_write_tab[ExtConfig & 7];
 
 	// Read byte
 	uint8 byte = read_byte(adr);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	read_tab = rt; write_tab = wt;
 
 	return byte;
 }
@@ -439,18 +546,23 @@ void MOS6510::ExtWriteByte(uint16 adr, uint8 byte)
 {
 	// Save old memory configuration
 	bool bi = basic_in, ki = kernal_in, ci = char_in, ii = io_in;
+	uint8 **rt = read_tab, **wt = write_tab;
 
-	// Set new configuration
+	// Set new configuration, decoded like the processor port in
+	// new_config() (the Char ROM is only seen where I/O is not)
 	basic_in = (ExtConfig & 3) == 3;
 	kernal_in = ExtConfig & 2;
-	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
+	char_in = (ExtConfig & 3) && !(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	read_tab = mem_read_tab[ExtConfig & 7];
+	write_tab = mem_write_tab[ExtConfig & 7];
 
 	// Write byte
 	write_byte(adr, byte);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	read_tab = rt; write_tab = wt;
 }
 
 
@@ -478,11 +590,20 @@ void MOS6510::REUWriteByte(uint16 adr, uint8 byte)
  *  Jump to address
  */
 
+#if DECODE_CACHE
+#define dec_ram() dec_base = ram_dec
+#define dec_rom() dec_base = rom_dec - 0xa000
+#else
+#define dec_ram()
+#define dec_rom()
+#endif
+
 #if PC_IS_POINTER
 #define jump(adr) \
 	if ((adr) < 0xa000) { \
 		pc = ram + (adr); \
 		pc_base = ram; \
+		dec_ram(); \
 	} else { \
 		switch ((adr) >> 12) { \
 			case 0xa: \
@@ -490,14 +611,17 @@ void MOS6510::REUWriteByte(uint16 adr, uint8 byte)
 				if (basic_in) { \
 					pc = basic_rom + ((adr) & 0x1fff); \
 					pc_base = basic_rom - 0xa000; \
+					dec_rom(); \
 				} else { \
 					pc = ram + (adr); \
 					pc_base = ram; \
+					dec_ram(); \
 				} \
 				break; \
 			case 0xc: \
 				pc = ram + (adr); \
 				pc_base = ram; \
+				dec_ram(); \
 				break; \
 			case 0xd: \
 				if (io_in) { \
@@ -505,9 +629,11 @@ void MOS6510::REUWriteByte(uint16 adr, uint8 byte)
 				} else if (char_in) { \
 					pc = char_rom + ((adr) & 0x0fff); \
 					pc_base = char_rom - 0xd000; \
+					dec_rom(); \
 				} else { \
 					pc = ram + (adr); \
 					pc_base = ram; \
+					dec_ram(); \
 				} \
 				break; \
 			case 0xe: \
@@ -515,9 +641,11 @@ void MOS6510::REUWriteByte(uint16 adr, uint8 byte)
 				if (kernal_in) { \
 					pc = kernal_rom + ((adr) & 0x1fff); \
 					pc_base = kernal_rom - 0xe000; \
+					dec_rom(); \
 				} else { \
 					pc = ram + (adr); \
 					pc_base = ram; \
+					dec_ram(); \
 				} \
 				break; \
 		} \
@@ -639,6 +767,9 @@ void MOS6510::SetState(MOS6510State *s)
 	ram[0] = s->ddr;
 	ram[1] = s->pr;
 	new_config();
+#if DECODE_CACHE
+	flush_decode_cache();
+#endif
 
 	jump(s->pc);
 	sp = s->sp & 0xff;
@@ -666,6 +797,9 @@ void MOS6510::Reset(void)
 	// Initialize extra 6510 registers and memory configuration
 	ram[0] = ram[1] = 0;
 	new_config();
+#if DECODE_CACHE
+	flush_decode_cache();
+#endif
 
 	// Clear all interrupt lines
 	interrupt.intr_any = 0;
@@ -747,6 +881,10 @@ int MOS6510::EmulateLine(int cycles_left)
 	uint8 tmp, tmp2;
 	uint16 adr;		// Used by read_adr_abs()!
 	int last_cycles = 0;
+#if DECODE_CACHE
+	DecodedOp *dop;
+	uint16 operand;	// Used by read_byte_imm() and read_adr_abs()!
+#endif
 
 	// Any pending interrupts?
 	if (interrupt.intr_any) {
@@ -784,7 +922,7 @@ handle_int:
 #include "CPU_emulline.h"
 
 		// Extension opcode
-		case 0xf2:
+		OP(0xf2):
 #if PC_IS_POINTER
 			if ((pc-pc_base) < 0xe000) {
 				illegal_op(0xf2, pc-pc_base-1);
@@ -794,6 +932,7 @@ handle_int:
 #endif
 				break;
 			}
+			the_c64->LoadActivity();
 			switch (read_byte_imm()) {
 				case 0x00:
 					ram[0x90] |= TheIEC->Out(ram[0x95], ram[0xa3] & 0x80);
@@ -36,6 +36,23 @@
 #define PRECISE_CPU_CYCLES 0
 #endif
 
+// Set this to 1 to dispatch opcodes through a table of labels (needs GCC's
+// computed goto) instead of the switch statement
+#ifndef THREADED_DISPATCH
+#if defined(__GNUC__)
+#define THREADED_DISPATCH 1
+#else
+#define THREADED_DISPATCH 0
+#endif
+#endif
+
+// Set this to 1 to keep decoded instructions (opcode label and operand)
+// per address instead of fetching them from memory (needs
+// THREADED_DISPATCH and PC_IS_POINTER)
+#ifndef DECODE_CACHE
+#define DECODE_CACHE 0
+#endif
+
 // Set this to 1 for instruction-aligned CIA emulation
 #ifndef PRECISE_CIA_CYCLES
 #define PRECISE_CIA_CYCLES 0
@@ -58,6 +75,7 @@ class MOS6526_2;
 class REU;
 class IEC;
 struct MOS6510State;
+struct MOS6510CycleState;
 
 
 // 6510 emulation (C64)
@@ -67,14 +85,22 @@ public:
 
 #ifdef FRODO_SC
 	void EmulateCycle(void);			// Emulate one clock cycle
+	void WakeUp(void);					// Leave an idle loop, memory may have been changed
 #else
 	int EmulateLine(int cycles_left);	// Emulate until cycles_left underflows
+#if DECODE_CACHE
+	void DecodeROM(void);				// ROM contents have changed
+#endif
 #endif
 	void Reset(void);
 	void AsyncReset(void);				// Reset the CPU asynchronously
 	void AsyncNMI(void);				// Raise NMI asynchronously (NMI pulse)
 	void GetState(MOS6510State *s);
 	void SetState(MOS6510State *s);
+#ifdef FRODO_SC
+	void GetCycleState(MOS6510CycleState *s);
+	void SetCycleState(MOS6510CycleState *s);
+#endif
 	uint8 ExtReadByte(uint16 adr);
 	void ExtWriteByte(uint16 adr, uint8 byte);
 	uint8 REUReadByte(uint16 adr);
@@ -111,7 +137,13 @@ private:
 	uint16 read_zp_word(uint16 adr);
 	void write_zp(uint16 adr, uint8 byte);
 
+	void init_mem_tabs(void);
 	void new_config(void);
+#if DECODE_CACHE && !defined(FRODO_SC)
+	void init_decode_cache(void *miss);
+	void flush_decode_cache(void);
+	void invalidate_code(uint16 adr);
+#endif
 	void illegal_op(uint8 op, uint16 at);
 	void illegal_jump(uint16 at, uint16 to);
 
@@ -120,6 +152,15 @@ private:
 
 	uint8 read_emulator_id(uint16 adr);
 
+#ifdef FRODO_SC
+	void idle_branch(uint16 target);
+	void idle_arrive(void);
+	void idle_write(const uint8 *page, uint16 adr, uint8 byte);
+	uint8 idle_io_read(uint16 adr);
+	bool idle_wake(void);
+	void idle_unpark(void);
+#endif
+
 	C64 *the_c64;		// Pointer to C64 object
 
 	uint8 *ram;			// Pointer to main RAM
@@ -148,12 +189,52 @@ private:
 	uint16 ar, ar2;			// Address registers
 	uint8 rdbuf;			// Data buffer for RMW instructions
 	uint8 ddr, pr, pr_out;	// Processor port
+
+	// Idle loop detection. An iteration of the loop at idle_pc is
+	// recorded, and if it ends in the state it started in, without
+	// changing memory and with at most one side-effect free I/O read, the CPU
+	// is parked: it only counts the cycles of the loop until an
+	// interrupt arrives or the I/O register changes.
+	uint16 idle_pc;			// Target of the last backward jump
+	bool idle_rec;			// Recording an iteration
+	bool idle_dirty;		// Iteration wrote to memory or read an unsafe register
+	int idle_rec_len;		// Cycles recorded so far (without stalled reads)
+	uint32 idle_writes;		// Write cycles of the iteration (bit mask)
+	uint32 idle_regs[3];	// CPU registers at the start of the iteration
+	int idle_io_phase;		// Cycle of the I/O read in the iteration (-1 = none)
+	uint16 idle_io_adr;		// Address of the I/O read
+	uint8 idle_io_val;		// Value it returned
+	int idle_len;			// Cycles per iteration while parked, 0 = running
+	int idle_phase;			// Cycle within the iteration while parked
+	unsigned long idle_mask;	// Interrupts that end the loop
 #else
 	int	borrowed_cycles;	// Borrowed cycles from next line
 #endif
 
 	bool basic_in, kernal_in, char_in, io_in;
 	uint8 dfff_byte;
+
+	// Page tables for the 8 memory configurations, one pointer per
+	// 256 byte page. NULL means "go through read/write_byte_io()".
+	uint8 *mem_read_tab[8][0x100];
+	uint8 *mem_write_tab[8][0x100];
+	uint8 **read_tab, **write_tab;	// Tables for current configuration
+
+#if DECODE_CACHE && !defined(FRODO_SC)
+	// Decoded instructions, one per address. RAM entries are reset to
+	// dec_miss when one of their bytes is written, ROM entries when the
+	// Kernal is patched. code_page[] marks RAM pages that have decoded
+	// entries.
+	struct DecodedOp {
+		void *handler;	// Opcode label, or dec_miss if not decoded
+		uint16 operand;	// The two bytes following the opcode
+	};
+	DecodedOp ram_dec[0x10000];
+	DecodedOp rom_dec[0x6000];	// $a000-$ffff (Basic, Char and Kernal ROM)
+	DecodedOp *dec_base;		// Entries for the memory pc points into
+	void *dec_miss;				// Label that decodes the instruction at pc
+	bool code_page[0x100];
+#endif
 };
 
 // 6510 state
@@ -168,6 +249,20 @@ struct MOS6510State {
 	bool instruction_complete;
 };
 
+#ifdef FRODO_SC
+// Frodo SC state that is not part of MOS6510State (and of the snapshot
+// files): the instruction in progress and the cycle timing
+struct MOS6510CycleState {
+	uint8 state, op;	// Current state and opcode
+	uint16 ar, ar2;		// Address registers
+	uint8 rdbuf;		// Data buffer for RMW instructions
+	uint8 pr_out;		// Processor port output latch
+	bool ba_low;		// BA line
+	uint32 irq_age;		// Cycles since IRQ/NMI were triggered
+	uint32 nmi_age;
+};
+#endif
+
 
 // Interrupt functions
 #ifdef FRODO_SC
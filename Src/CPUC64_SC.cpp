@@ -48,6 +48,9 @@
  *  - All memory accesses are done with the read_byte() and
  *    write_byte() functions which also do the memory address
  *    decoding.
+ *  - RAM and ROM pages are decoded through per-configuration
+ *    page tables (mem_read_tab/mem_write_tab), I/O pages and
+ *    the processor port go the slow way
  *  - If a write occurs to addresses 0 or 1, new_config is
  *    called to check whether the memory configuration has
  *    changed
@@ -63,6 +66,23 @@
  *    used to implement emulator-specific functions, mainly
  *    those for the IEC routines
  *
+ * Idle loops:
+ *  - The target of every backward branch or jump becomes idle_pc.
+ *    When the opcode at idle_pc is fetched, recording of one
+ *    iteration starts. If the next fetch at idle_pc finds the same
+ *    registers, nothing in memory was changed (storing the value
+ *    that is already there is fine) and at most one I/O register
+ *    without read side effects was read, every further iteration
+ *    will be the same as long as that register returns the same
+ *    value. The CPU is then parked: EmulateCycle() only counts the
+ *    cycles of the loop that BA doesn't stall (idle_phase).
+ *  - The loop is left when an interrupt that it would take is
+ *    pending, when the watched I/O register returns something else
+ *    in the cycle it is read, or on WakeUp() (VBlank, before anything
+ *    outside of the CPU can change memory). The cycles of the
+ *    current iteration are then replayed instantly, and emulation
+ *    continues cycle by cycle exactly where the loop was.
+ *
  * Incompatibilities:
  * ------------------
  *
@@ -103,6 +123,52 @@ MOS6510::MOS6510(C64 *c64, uint8 *Ram, uint8 *Basic, uint8 *Kernal, uint8 *Char,
 	dfff_byte = 0x55;
 	BALow = false;
 	first_irq_cycle = first_nmi_cycle = 0;
+	idle_pc = 0;
+	idle_rec = false;
+	idle_len = 0;
+
+	init_mem_tabs();
+	read_tab = mem_read_tab[7];
+	write_tab = mem_write_tab[7];
+}
+
+
+/*
+ *  Set up the page tables for all 8 memory configurations
+ */
+
+void MOS6510::init_mem_tabs(void)
+{
+	for (int config=0; config<8; config++) {
+		bool basic = (config & 3) == 3;
+		bool kernal = config & 2;
+		bool chr = (config & 3) && !(config & 4);
+		bool io = (config & 3) && (config & 4);
+		uint8 **rd = mem_read_tab[config];
+		uint8 **wr = mem_write_tab[config];
+
+		for (int page=0; page<0x100; page++) {
+			uint8 *r = ram + (page << 8);
+			uint8 *w = ram + (page << 8);
+
+			if (page >= 0xa0 && page < 0xc0 && basic)
+				r = basic_rom + ((page - 0xa0) << 8);
+			else if (page >= 0xd0 && page < 0xe0) {
+				if (io)
+					r = w = NULL;
+				else if (chr)
+					r = char_rom + ((page - 0xd0) << 8);
+			} else if (page >= 0xe0 && kernal)
+				r = kernal_rom + ((page - 0xe0) << 8);
+
+			// $ff00 triggers REU DMA
+			if (page == 0xff)
+				w = NULL;
+
+			rd[page] = r;
+			wr[page] = w;
+		}
+	}
 }
 
 
@@ -133,6 +199,9 @@ void MOS6510::AsyncNMI(void)
 
 void MOS6510::GetState(MOS6510State *s)
 {
+	if (idle_len)
+		idle_unpark();
+
 	s->a = a;
 	s->x = x;
 	s->y = y;
@@ -193,6 +262,40 @@ void MOS6510::SetState(MOS6510State *s)
 	dfff_byte = s->dfff_byte;
 	if (s->instruction_complete)
 		state = 0;
+	idle_rec = false;
+	idle_len = 0;
+}
+
+
+/*
+ *  Get/restore the state not held by MOS6510State (call after GetState()
+ *  and SetState())
+ */
+
+void MOS6510::GetCycleState(MOS6510CycleState *s)
+{
+	s->state = state;
+	s->op = op;
+	s->ar = ar;
+	s->ar2 = ar2;
+	s->rdbuf = rdbuf;
+	s->pr_out = pr_out;
+	s->ba_low = BALow;
+	s->irq_age = the_c64->CycleCounter - first_irq_cycle;
+	s->nmi_age = the_c64->CycleCounter - first_nmi_cycle;
+}
+
+void MOS6510::SetCycleState(MOS6510CycleState *s)
+{
+	state = s->state;
+	op = s->op;
+	ar = s->ar;
+	ar2 = s->ar2;
+	rdbuf = s->rdbuf;
+	pr_out = s->pr_out;
+	BALow = s->ba_low;
+	first_irq_cycle = the_c64->CycleCounter - s->irq_age;
+	first_nmi_cycle = the_c64->CycleCounter - s->nmi_age;
 }
 
 
@@ -209,6 +312,9 @@ void MOS6510::new_config(void)
 	kernal_in = port & 2;
 	char_in = (port & 3) && !(port & 4);
 	io_in = (port & 3) && (port & 4);
+
+	read_tab = mem_read_tab[port & 7];
+	write_tab = mem_write_tab[port & 7];
 }
 
 
@@ -280,18 +386,20 @@ inline uint8 MOS6510::read_byte_io(uint16 adr)
 
 uint8 MOS6510::read_byte(uint16 adr)
 {
-	if (adr < 0xa000) {
-		if (adr >= 2) {
-			return ram[adr];
-		} else if (adr == 0) {
-			return ddr;
-		} else {
-			uint8 byte = (pr | ~ddr) & (pr_out | 0x17);
-			if (!(ddr & 0x20))
-				byte &= 0xdf;
-			return byte;
-		}
-	} else
+	uint8 *page = read_tab[adr >> 8];
+
+	if (page != NULL && adr >= 2)
+		return page[adr & 0xff];
+	else if (adr == 0)
+		return ddr;
+	else if (adr == 1) {
+		uint8 byte = (pr | ~ddr) & (pr_out | 0x17);
+		if (!(ddr & 0x20))
+			byte &= 0xdf;
+		return byte;
+	} else if (idle_rec)
+		return idle_io_read(adr);
+	else
 		return read_byte_io(adr);
 }
 
@@ -330,7 +438,6 @@ inline uint16 MOS6510::read_word(uint16 adr)
 }
 
 
-extern C64 *TheC64;
 /*
  *  Write a byte to I/O space
  */
@@ -339,6 +446,7 @@ inline void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 {
 	if (adr >= 0xe000) {
 		ram[adr] = byte;
+		the_c64->RAMDirty[adr >> 8] = true;
 		if (adr == 0xff00)
 			TheREU->FF00Trigger();
 	} else if (io_in)
@@ -353,7 +461,7 @@ inline void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 			case 0x5:
 			case 0x6:
 			case 0x7:
-				if (TheC64->network_connection_type != CLIENT)
+				if (the_c64->network_connection_type != CLIENT)
 					TheSID->WriteRegister(adr & 0x1f, byte);
 				return;
 			case 0x8:	// Color RAM
@@ -374,8 +482,10 @@ inline void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 					TheREU->WriteRegister(adr & 0x0f, byte);
 				return;
 		}
-	else
-		ram[adr] = byte;	
+	else {
+		ram[adr] = byte;
+		the_c64->RAMDirty[adr >> 8] = true;
+	}
 }
 
 
@@ -385,18 +495,26 @@ inline void MOS6510::write_byte_io(uint16 adr, uint8 byte)
 
 void MOS6510::write_byte(uint16 adr, uint8 byte)
 {
-	if (adr < 0xd000) {
-		if (adr >= 2)
-			ram[adr] = byte;
-		else if (adr == 0) {
-			ddr = byte;
-			ram[0] = TheVIC->LastVICByte;
-			new_config();
-		} else {
-			pr = byte;
-			ram[1] = TheVIC->LastVICByte;
-			new_config();
-		}
+	uint8 *page = write_tab[adr >> 8];
+
+	if (idle_rec)
+		idle_write(page, adr, byte);
+	if (page != NULL && adr >= 2) {
+		page[adr & 0xff] = byte;
+		the_c64->RAMDirty[adr >> 8] = true;
+		return;
+	}
+
+	if (adr == 0) {
+		ddr = byte;
+		ram[0] = TheVIC->LastVICByte;
+		the_c64->RAMDirty[0] = true;
+		new_config();
+	} else if (adr == 1) {
+		pr = byte;
+		ram[1] = TheVIC->LastVICByte;
+		the_c64->RAMDirty[0] = true;
+		new_config();
 	} else
 		write_byte_io(adr, byte);
 }
@@ -410,18 +528,23 @@ uint8 MOS6510::ExtReadByte(uint16 adr)
 {
 	// Save old memory configuration
 	bool bi = basic_in, ki = kernal_in, ci = char_in, ii = io_in;
+	uint8 **rt = read_tab, **wt = write_tab;
 
-	// Set new configuration
+	// Set new configuration, decoded like the processor port in
+	// new_config() (the Char ROM is only seen where I/O is not)
 	basic_in = (ExtConfig & 3) == 3;
 	kernal_in = ExtConfig & 2;
-	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
+	char_in = (ExtConfig & 3) && !(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	read_tab = mem_read_tab[ExtConfig & 7];
+	write_tab = mem_write_tab[ExtConfig & 7];
 
 	// Read byte
 	uint8 byte = read_byte(adr);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	read_tab = rt; write_tab = wt;
 
 	return byte;
 }
@@ -435,18 +558,23 @@ void MOS6510::ExtWriteByte(uint16 adr, uint8 byte)
 {
 	// Save old memory configuration
 	bool bi = basic_in, ki = kernal_in, ci = char_in, ii = io_in;
+	uint8 **rt = read_tab, **wt = write_tab;
 
-	// Set new configuration
+	// Set new configuration, decoded like the processor port in
+	// new_config() (the Char ROM is only seen where I/O is not)
 	basic_in = (ExtConfig & 3) == 3;
 	kernal_in = ExtConfig & 2;
-	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
+	char_in = (ExtConfig & 3) && !(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	read_tab = mem_read_tab[ExtConfig & 7];
+	write_tab = mem_write_tab[ExtConfig & 7];
 
 	// Write byte
 	write_byte(adr, byte);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	read_tab = rt; write_tab = wt;
 }
 
 
@@ -550,8 +678,10 @@ void MOS6510::Reset(void)
 {
 	// Delete 'CBM80' if present
 	if (ram[0x8004] == 0xc3 && ram[0x8005] == 0xc2 && ram[0x8006] == 0xcd
-	 && ram[0x8007] == 0x38 && ram[0x8008] == 0x30)
+	 && ram[0x8007] == 0x38 && ram[0x8008] == 0x30) {
 		ram[0x8004] = 0;
+		the_c64->RAMDirty[0x80] = true;
+	}
 
 	// Initialize extra 6510 registers and memory configuration
 	ddr = pr = pr_out = 0;
@@ -561,6 +691,9 @@ void MOS6510::Reset(void)
 	interrupt.intr_any = 0;
 	nmi_state = false;
 
+	idle_rec = false;
+	idle_len = 0;
+
 	// Read reset vector
 	pc = read_word(0xfffc);
 	state = 0;
@@ -582,6 +715,167 @@ void MOS6510::illegal_op(uint8 op, uint16 at)
 }
 
 
+/*
+ *  Idle loops: Backward branch or jump to target
+ */
+
+inline void MOS6510::idle_branch(uint16 target)
+{
+	if (target != idle_pc) {
+		idle_pc = target;
+		idle_rec = false;
+	}
+}
+
+
+/*
+ *  Idle loops: Opcode at idle_pc fetched, park the CPU if the
+ *  iteration just ended was idle, else record the next one
+ */
+
+const int IDLE_MAX_CYCLES = 32;	// Longest loop that is parked (bits in idle_writes)
+
+void MOS6510::idle_arrive(void)
+{
+	uint32 regs0 = a | (x << 8) | (y << 16) | (sp << 24);
+	uint32 regs1 = n_flag | (z_flag << 8) | (rdbuf << 16)
+		| (v_flag << 24) | (d_flag << 25) | (i_flag << 26) | (c_flag << 27);
+	uint32 regs2 = ar | (ar2 << 16);
+
+	if (idle_rec && !idle_dirty && idle_rec_len <= IDLE_MAX_CYCLES + 1
+	 && regs0 == idle_regs[0] && regs1 == idle_regs[1] && regs2 == idle_regs[2]) {
+		union {
+			uint8 intr[4];
+			unsigned long intr_any;
+		} mask;
+		mask.intr_any = 0;
+		mask.intr[INT_NMI] = mask.intr[INT_RESET] = 0xff;
+		if (!i_flag)
+			mask.intr[INT_VICIRQ] = mask.intr[INT_CIAIRQ] = 0xff;
+
+		if (!(interrupt.intr_any & mask.intr_any)) {
+			idle_mask = mask.intr_any;
+			idle_len = idle_rec_len - 1;	// Without this fetch
+			idle_phase = 1;					// This fetch
+			idle_rec = false;
+			return;
+		}
+	}
+
+	idle_rec = true;
+	idle_dirty = false;
+	idle_rec_len = 1;
+	idle_writes = 0;
+	idle_io_phase = -1;
+	idle_regs[0] = regs0;
+	idle_regs[1] = regs1;
+	idle_regs[2] = regs2;
+}
+
+
+/*
+ *  Idle loops: Write cycle while recording (before the write to page),
+ *  unlike reads it is not stalled by BA. Writes of the value already in
+ *  RAM have no effect and are allowed in the loop, all others make the
+ *  iteration dirty. Memory can't be written while the CPU is parked,
+ *  VBlank() unparks it before the GUI or the monitor get to it.
+ */
+
+inline void MOS6510::idle_write(const uint8 *page, uint16 adr, uint8 byte)
+{
+	if (BALow)
+		idle_rec_len++;
+	if (idle_rec_len <= IDLE_MAX_CYCLES)
+		idle_writes |= 1u << (idle_rec_len - 1);
+	if (page == NULL || adr < 2 || page[adr & 0xff] != byte)
+		idle_dirty = true;
+}
+
+
+/*
+ *  Idle loops: I/O read while recording. Only VIC registers other
+ *  than the collision registers and the CIA ports and control
+ *  registers can be watched, anything else ends the recording.
+ */
+
+uint8 MOS6510::idle_io_read(uint16 adr)
+{
+	uint8 byte = read_byte_io(adr);
+	bool vic = (adr & 0xfc00) == 0xd000 && (adr & 0x3e) != 0x1e;
+	bool cia = (adr & 0xfe00) == 0xdc00 && ((adr & 0x0f) < 4 || (adr & 0x0f) >= 0x0e);
+
+	if ((vic || cia) && idle_io_phase < 0) {
+		idle_io_phase = idle_rec_len - 1;
+		idle_io_adr = adr;
+		idle_io_val = byte;
+	} else
+		idle_dirty = true;
+	return byte;
+}
+
+
+/*
+ *  Idle loops: Count one cycle while parked, returns true if the
+ *  loop has to be left (the CPU is unparked then)
+ */
+
+inline bool MOS6510::idle_wake(void)
+{
+	if (!(interrupt.intr_any & idle_mask) && !idle_dirty) {
+		if (BALow && !(idle_writes & (1u << idle_phase)))
+			return false;	// Read cycle stalled by BA
+		if (idle_phase != idle_io_phase || read_byte_io(idle_io_adr) == idle_io_val) {
+			if (++idle_phase == idle_len)
+				idle_phase = 0;
+			return false;
+		}
+	}
+	idle_unpark();
+	return true;
+}
+
+
+/*
+ *  Idle loops: Leave the loop, bring the registers to where the
+ *  current iteration is by replaying its cycles (none of them
+ *  changes memory or reads anything that changed since parking)
+ */
+
+void MOS6510::idle_unpark(void)
+{
+	idle_len = 0;
+
+	if (idle_phase == 0) {	// Opcode at idle_pc not yet fetched
+		pc = idle_pc;
+		state = 0;
+	} else {
+		unsigned long intr = interrupt.intr_any;
+		uint32 irq_cycle = first_irq_cycle, nmi_cycle = first_nmi_cycle;
+		bool ba = BALow;
+
+		interrupt.intr_any = 0;
+		BALow = false;
+		for (int i=1; i<idle_phase; i++)
+			EmulateCycle();
+		interrupt.intr_any = intr;
+		first_irq_cycle = irq_cycle;
+		first_nmi_cycle = nmi_cycle;
+		BALow = ba;
+	}
+}
+
+
+/*
+ *  Leave an idle loop (called on VBlank, RAM may be changed from outside)
+ */
+
+void MOS6510::WakeUp(void)
+{
+	if (idle_len)
+		idle_unpark();
+}
+
+
 /*
  *  Emulate one 6510 clock cycle
  */
@@ -602,6 +896,12 @@ void MOS6510::EmulateCycle(void)
 {
 	uint8 data, tmp;
 
+	// Parked in an idle loop?
+	if (idle_len && !idle_wake())
+		return;
+	if (idle_rec && !BALow)
+		idle_rec_len++;
+
 	// Any pending interrupts in state 0 (opcode fetch)?
 	if (!state && interrupt.intr_any) {
 		if (interrupt.intr[INT_RESET])
@@ -621,6 +921,14 @@ void MOS6510::EmulateCycle(void)
 				illegal_op(0xf2, pc-1);
 				break;
 			}
+			the_c64->LoadActivity();
+			// Drive accesses can't be taken back, frames that are run
+			// ahead wait here until the real timeline gets to them
+			if (the_c64->RunningAhead()) {
+				pc--;
+				Last;
+			}
+			the_c64->RAMDirty[0] = true;	// ST at $90
 			switch (read_byte(pc++)) {
 				case 0x00:
 					ram[0x90] |= TheIEC->Out(ram[0x95], ram[0xa3] & 0x80);
@@ -51,11 +51,21 @@
  *  Other macros
  */
 
+// Jump to target, a backward one may start an idle loop (6510 only)
+#ifdef IS_CPU_1541
+#define IdleJump(target)
+#else
+#define IdleJump(target) \
+		if ((target) < pc) \
+			idle_branch(target);
+#endif
+
 // Branch (cycle 1)
 #define Branch(flag) \
 		read_to(pc++, data);  \
 		if (flag) { \
 			ar = pc + (int8)data; \
+			IdleJump(ar); \
 			if ((ar >> 8) != (pc >> 8)) { \
 				if (data & 0x80) \
 					state = O_BRANCH_BP; \
@@ -91,6 +101,10 @@
 		case 0:
 			read_to(pc++, op);
 			state = ModeTab[op];
+#ifndef IS_CPU_1541
+			if ((uint16)(pc - 1) == idle_pc)
+				idle_arrive();
+#endif
 			break;
 
 
@@ -750,6 +764,7 @@
 			break;
 		case O_JMP1:
 			read_to(pc, data);
+			IdleJump((data << 8) | ar);
 			pc = (data << 8) | ar;
 			Last;
 
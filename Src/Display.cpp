@@ -30,6 +30,7 @@
 #include "Prefs.h"
 #include "C64.h"
 #include "CIA.h"
+#include "VIC.h"
 #include "utils.hh"
 
 #include "gui/gui.hh"
@@ -94,9 +95,16 @@ void C64Display::UpdateLEDs(int l0, int l1, int l2, int l3)
 	led_state[3] = l3;
 }
 
+bool C64Display::DriveLEDOn(void)
+{
+	for (int i=0; i<4; i++)
+		if (led_state[i] == LED_ON)
+			return true;
+	return false;
+}
+
 
 // Display surface
-static Uint8 screen[DISPLAY_X * DISPLAY_Y];
 //static Uint16 *screen_16;
 //static Uint32 *screen_32;
 static int screen_bits_per_pixel;
@@ -110,6 +118,17 @@ static bool num_locked = false;
 // SDL joysticks
 static SDL_Joystick *joy[2] = {NULL, NULL};
 
+// Serializes the GUI between the emulation and the presenter thread
+static SDL_mutex *gui_lock;
+
+// Protects the event queue and the joystick list. The presenter thread
+// makes all SDL video and event calls, so this is never held while
+// frames are converted or flipped.
+static SDL_mutex *input_lock;
+
+// Set in shared_buf when the buffer holds a frame not yet presented
+const int FRAME_FRESH = 4;
+
 static Uint16 palette_16[PALETTE_SIZE];
 static Uint32 palette_32[PALETTE_SIZE];
 SDL_Color sdl_palette[PALETTE_SIZE];
@@ -220,15 +239,40 @@ int init_graphics(void)
 C64Display::C64Display(C64 *the_c64) : TheC64(the_c64)
 {
 	quit_requested = false;
+	rewind_held = false;
+	memset(frame_buf, 0, sizeof(frame_buf));
+	back_buf = 0;
+	front_buf = 1;
+	shared_buf = 2;
+	presenter_quit = false;
+	presenter = NULL;
+	frame_ready = NULL;
+	event_count = 0;
+	memset(pending_dirty, 0, sizeof(pending_dirty));
+	peer_frame = false;
+	gui_drawn = true;		// Draw the first frame completely
 	speedometer_string[0] = 0;
 	networktraffic_string[0] = 0;
 	this->text_message_send = NULL;
 
 	// Open window
-	SDL_WM_SetCaption(VERSION_STRING, "Frodo");
+	if (!HeadlessMode)
+		SDL_WM_SetCaption(VERSION_STRING, "Frodo");
 	// LEDs off
 	for (int i=0; i<4; i++)
 		led_state[i] = old_led_state[i] = LED_OFF;
+
+	// Start presenter thread
+	if (!HeadlessMode) {
+		if (!gui_lock)
+			gui_lock = SDL_CreateMutex();
+		if (!input_lock)
+			input_lock = SDL_CreateMutex();
+		frame_ready = SDL_CreateSemaphore(0);
+		presenter = SDL_CreateThread(presenter_func, this);
+		panic_if(!gui_lock || !input_lock || !frame_ready || !presenter,
+				"Can't start presenter thread: %s\n", SDL_GetError());
+	}
 }
 
 
@@ -238,6 +282,13 @@ C64Display::C64Display(C64 *the_c64) : TheC64(the_c64)
 
 C64Display::~C64Display()
 {
+	if (presenter) {
+		presenter_quit = true;
+		SDL_SemPost(frame_ready);
+		SDL_WaitThread(presenter, NULL);
+	}
+	if (frame_ready)
+		SDL_DestroySemaphore(frame_ready);
 	SDL_Quit();
 }
 
@@ -254,7 +305,7 @@ void C64Display::NewPrefs(Prefs *prefs)
 /*
  *  Redraw bitmap
  */
-void C64Display::Update_32(uint8 *src_pixels)
+void C64Display::Update_32(uint8 *src_pixels, const uint32 *dirty)
 {
 	const Uint16 src_pitch = DISPLAY_X;
 	const int x_border = (DISPLAY_X - FULL_DISPLAY_X / 2) / 2;
@@ -265,6 +316,8 @@ void C64Display::Update_32(uint8 *src_pixels)
 	/* Center, double size */
 	for (int y = y_border; y < (FULL_DISPLAY_Y/2) + y_border; y++)
 	{
+		if (dirty && !LineDirty(dirty, y))
+			continue;
 		for (int x = x_border; x < (FULL_DISPLAY_X / 2 + x_border); x++)
 		{
 			int src_off = y * src_pitch + x;
@@ -279,7 +332,7 @@ void C64Display::Update_32(uint8 *src_pixels)
 	}
 }
 
-void C64Display::Update_16(uint8 *src_pixels)
+void C64Display::Update_16(uint8 *src_pixels, const uint32 *dirty)
 {
 	const Uint16 src_pitch = DISPLAY_X;
 
@@ -296,6 +349,8 @@ void C64Display::Update_16(uint8 *src_pixels)
 		/* Draw 1-1 */
 		for (int y = 0; y < DISPLAY_Y; y++)
 		{
+			if (dirty && !LineDirty(dirty, y))
+				continue;
 			for (int x = 0; x < DISPLAY_X; x++)
 			{
 				int src_off = y * src_pitch + x;
@@ -322,6 +377,8 @@ void C64Display::Update_16(uint8 *src_pixels)
 	/* Center, double size */
 	for (int y = y_border; y < (FULL_DISPLAY_Y/2) + y_border; y++)
 	{
+		if (dirty && !LineDirty(dirty, y))
+			continue;
 		for (int x = x_border; x < (FULL_DISPLAY_X / 2 + x_border); x++)
 		{
 			int src_off = y * src_pitch + x;
@@ -338,7 +395,7 @@ void C64Display::Update_16(uint8 *src_pixels)
 
 }
 
-void C64Display::Update_8(uint8 *src_pixels)
+void C64Display::Update_8(uint8 *src_pixels, const uint32 *dirty)
 {
 	const Uint16 src_pitch = DISPLAY_X;
 	const int x_border = (DISPLAY_X - FULL_DISPLAY_X / 2) / 2;
@@ -349,6 +406,8 @@ void C64Display::Update_8(uint8 *src_pixels)
 	/* Center, double size */
 	for (int y = y_border; y < (FULL_DISPLAY_Y/2) + y_border; y++)
 	{
+		if (dirty && !LineDirty(dirty, y))
+			continue;
 		for (int x = x_border; x < (FULL_DISPLAY_X / 2 + x_border); x++)
 		{
 			int src_off = y * src_pitch + x;
@@ -387,8 +446,32 @@ void C64Display::Update_stretched(uint8 *src_pixels)
 	SDL_SoftStretch(sdl_screen, &srcrect, real_screen, &dstrect);
 }
 
-void C64Display::Update(uint8 *src_pixels)
+/*
+ *  Convert the lines of the frame that changed to the screen and draw the
+ *  GUI on top. Frames without changes are skipped if there is no GUI.
+ *  Only the GUI is drawn under the GUI lock, so the emulation thread
+ *  never waits for the conversion or the flip.
+ */
+
+void C64Display::present_frame(uint8 *src_pixels, const uint32 *dirty)
 {
+	bool changed = false, gui_shown;
+
+	for (int i=0; i<DIRTY_WORDS; i++)
+		if (dirty[i])
+			changed = true;
+
+	SDL_mutexP(gui_lock);
+	gui_shown = Gui::gui->hasOverlay() || this->speedometer_shown();
+	SDL_mutexV(gui_lock);
+	if (!changed && !gui_shown && !this->gui_drawn)
+		return;
+
+	// The lines under the last GUI are redrawn, and all of them if the
+	// screen is double-buffered and holds an older frame
+	if (this->gui_drawn || (real_screen->flags & SDL_DOUBLEBUF))
+		dirty = NULL;
+
 	if (0)
 		this->Update_stretched(src_pixels);
 	else
@@ -396,23 +479,130 @@ void C64Display::Update(uint8 *src_pixels)
 		switch (screen_bits_per_pixel)
 		{
 		case 8:
-			this->Update_8(src_pixels); break;
+			this->Update_8(src_pixels, dirty); break;
 		case 16:
-			this->Update_16(src_pixels); break;
+			this->Update_16(src_pixels, dirty); break;
 		case 24:
 		case 32:
 		default:
-			this->Update_32((Uint8*)src_pixels); break;
+			this->Update_32((Uint8*)src_pixels, dirty); break;
 		}
 	}
+	SDL_mutexP(gui_lock);
+	this->gui_drawn = Gui::gui->hasOverlay() || this->speedometer_shown();
 	Gui::gui->draw(real_screen);
+	if (this->speedometer_shown()) {
+		Font *font = Gui::gui->small_font;
+		int w = font->getWidth(this->speedometer_string);
+
+		font->draw(real_screen, this->speedometer_string,
+				real_screen->w - w - 16, 12, w, font->getHeight(this->speedometer_string));
+	}
+	SDL_mutexV(gui_lock);
 
 	SDL_Flip(real_screen);
 }
 
+
+/*
+ *  Presenter: Poll the SDL events and the joysticks into the queue for
+ *  PollKeyboard(). SDL 1.2 is not thread-safe (on X11 the video and the
+ *  events share one connection), so this happens on the thread that
+ *  flips the frames. If the queue is full, newer events are dropped.
+ */
+
+void C64Display::pump_events(void)
+{
+	SDL_Event event;
+
+	SDL_mutexP(input_lock);
+	SDL_JoystickUpdate();
+	while (SDL_PollEvent(&event))
+		if (event_count < EVENT_QUEUE_SIZE)
+			event_queue[event_count++] = event;
+	SDL_mutexV(input_lock);
+}
+
+
+/*
+ *  Presenter thread: scale, draw the GUI on top and flip whenever
+ *  the emulation has handed over a new frame, and poll the input
+ *  every time it is woken up
+ */
+
+int C64Display::presenter_func(void *display)
+{
+	C64Display *d = (C64Display *)display;
+
+	for (;;) {
+		SDL_SemWait(d->frame_ready);
+		if (d->presenter_quit)
+			break;
+
+		// Swap the fresh frame for the one we showed last
+		if (d->shared_buf & FRAME_FRESH) {
+			d->front_buf = __sync_lock_test_and_set(&d->shared_buf, d->front_buf) & 3;
+			d->present_frame(d->frame_buf[d->front_buf], d->frame_dirty[d->front_buf]);
+		}
+		d->pump_events();
+	}
+	return 0;
+}
+
+
+/*
+ *  Hand the finished frame over to the presenter thread and continue
+ *  in another buffer, never waiting for the presenter. dirty are the
+ *  lines that changed since the frame before (NULL: all lines).
+ */
+
+void C64Display::hand_over(const uint32 *dirty)
+{
+	// Collect the changes of all frames since the one the presenter
+	// took last, the frames in between are replaced without being shown
+	if (!(shared_buf & FRAME_FRESH))
+		memset(pending_dirty, 0, sizeof(pending_dirty));
+	for (int i=0; i<DIRTY_WORDS; i++)
+		pending_dirty[i] |= dirty ? dirty[i] : ~0;
+	memcpy(frame_dirty[back_buf], pending_dirty, sizeof(pending_dirty));
+
+	__sync_synchronize();
+	back_buf = __sync_lock_test_and_set(&shared_buf, back_buf | FRAME_FRESH) & 3;
+	if (SDL_SemValue(frame_ready) == 0)
+		SDL_SemPost(frame_ready);
+}
+
 void C64Display::Update()
 {
-	this->Update((Uint8*)screen);
+	MOS6569 *vic = TheC64->TheVIC;
+
+	// The VIC's changes are relative to its own last frame
+	hand_over(this->peer_frame ? NULL : vic->DirtyLines());
+	vic->ClearDirtyLines();
+	this->peer_frame = false;
+}
+
+void C64Display::Update(uint8 *src_pixels)
+{
+	memcpy(frame_buf[back_buf], src_pixels, sizeof(frame_buf[back_buf]));
+	this->peer_frame = true;
+	hand_over(NULL);
+}
+
+
+/*
+ *  Keep the presenter from drawing the GUI while the emulation thread
+ *  feeds it input and runs its logic
+ */
+
+void C64Display::LockGui(void)
+{
+	SDL_mutexP(gui_lock);
+}
+
+void C64Display::UnlockGui(void)
+{
+	SDL_mutexV(gui_lock);
 }
 
 SDL_Surface *C64Display::SurfaceFromC64Display()
@@ -447,7 +637,7 @@ SDL_Surface *C64Display::SurfaceFromC64Display()
 		{
 			int src_off = (y * 2) * src_pitch + (x * 2);
 			int dst_off = y * out->pitch + x;
-			Uint8 v = screen[src_off];
+			Uint8 v = frame_buf[back_buf][src_off];
 
 			dst_pixels[ dst_off ] = v;
 		}
@@ -462,18 +652,24 @@ SDL_Surface *C64Display::SurfaceFromC64Display()
  */
 
 /*
- *  Draw speedometer
+ *  Set the speedometer: Speed in percent and the frame skip, one of
+ *  skip frames is drawn
  */
 
-void C64Display::Speedometer(int speed)
+void C64Display::Speedometer(int speed, int skip)
 {
-	static int delay = 0;
+	SDL_mutexP(gui_lock);
+	if (skip > 1)
+		snprintf(speedometer_string, sizeof(speedometer_string), "%d%% 1/%d", speed, skip);
+	else
+		snprintf(speedometer_string, sizeof(speedometer_string), "%d%%", speed);
+	SDL_mutexV(gui_lock);
+}
 
-	if (delay >= 20) {
-		delay = 0;
-		sprintf(speedometer_string, "%d%%", speed);
-	} else
-		delay++;
+// Presenter: Is the speedometer drawn over the frame? (GUI lock held)
+bool C64Display::speedometer_shown(void)
+{
+	return ThePrefs.ShowSpeed && this->speedometer_string[0] && Gui::gui->small_font;
 }
 
 void C64Display::NetworkTrafficMeter(float kb_per_s, bool is_throttled)
@@ -488,7 +684,7 @@ void C64Display::NetworkTrafficMeter(float kb_per_s, bool is_throttled)
 
 uint8 *C64Display::BitmapBase(void)
 {
-	return screen;
+	return frame_buf[back_buf];
 }
 
 
@@ -741,10 +937,28 @@ void C64Display::TypeNetworkMessage(bool broadcast)
 }
 
 
+/*
+ *  Handle the input events the presenter thread has polled since the
+ *  last call (emulation thread, in VBlank)
+ */
+
 void C64Display::PollKeyboard(uint8 *key_matrix, uint8 *rev_matrix, uint8 *joystick)
 {
-	SDL_Event event;
-	while (SDL_PollEvent(&event)) {
+	SDL_Event events[EVENT_QUEUE_SIZE];
+	int count;
+
+	// Take the events the presenter has polled, and have it poll again
+	SDL_mutexP(input_lock);
+	count = event_count;
+	memcpy(events, event_queue, count * sizeof(SDL_Event));
+	event_count = 0;
+	SDL_mutexV(input_lock);
+	if (SDL_SemValue(frame_ready) == 0)
+		SDL_SemPost(frame_ready);
+
+	for (int i=0; i<count; i++) {
+		SDL_Event &event = events[i];
+
 		Gui::gui->pushEvent(&event);
 
 		/* Ignore keyboard input while the menu is active */
@@ -764,6 +978,10 @@ void C64Display::PollKeyboard(uint8 *key_matrix, uint8 *rev_matrix, uint8 *joyst
 							this->TypeNetworkMessage();
 						break;
 
+					case SDLK_F9:	// F9: Rewind while held
+						rewind_held = true;
+						break;
+
 					case SDLK_F11:	// F11: NMI (Restore)
 						TheC64->NMI();
 						break;
@@ -797,6 +1015,8 @@ void C64Display::PollKeyboard(uint8 *key_matrix, uint8 *rev_matrix, uint8 *joyst
 
 			// Key released
 			case SDL_KEYUP:
+				if (event.key.keysym.sym == SDLK_F9)
+					rewind_held = false;
 				TranslateKey(event.key.keysym.sym, true, key_matrix, rev_matrix, joystick);
 				break;
 
@@ -831,7 +1051,11 @@ void C64::open_joystick(int port)
 {
 	joy_minx[port] = joy_miny[port] = -32767;	// Reset calibration
 	joy_maxx[port] = joy_maxy[port] = 32768;
+	if (HeadlessMode)
+		return;
+	SDL_mutexP(input_lock);
 	joy[port] = SDL_JoystickOpen(port);
+	SDL_mutexV(input_lock);
 	if (joy[port] == NULL)
 		fprintf(stderr, "Couldn't open joystick %d\n", port + 1);
 }
@@ -839,8 +1063,10 @@ void C64::open_joystick(int port)
 void C64::close_joystick(int port)
 {
 	if (joy[port]) {
+		SDL_mutexP(input_lock);
 		SDL_JoystickClose(joy[port]);
 		joy[port] = NULL;
+		SDL_mutexV(input_lock);
 	}
 }
 
@@ -1108,6 +1334,13 @@ void C64Display::InitColors(uint8 *colors)
 	sdl_palette[green].g = 0xf0;
 	sdl_palette[green].r = sdl_palette[green].b = 0;
 
+	for (int i=0; i<256; i++)
+		colors[i] = i & 0x0f;
+
+	// Headless mode only has the 8 bit bitmap
+	if (HeadlessMode)
+		return;
+
 	if (real_screen->format->BitsPerPixel == 8)
 		SDL_SetColors(real_screen, sdl_palette, 0, PALETTE_SIZE);
  	for (int i = 0; i < PALETTE_SIZE; i++) {
@@ -1127,9 +1360,6 @@ void C64Display::InitColors(uint8 *colors)
 		palette_16[i] = (((r >> rl) << rs) & rm) | (((g >> gl) << gs) & gm) | (((b >> bl) << bs) & bm);
 		palette_32[i] = (((r >> rl) << rs) & rm) | (((g >> gl) << gs) & gm) | (((b >> bl) << bs) & bm);
 	}
-
-	for (int i=0; i<256; i++)
-		colors[i] = i & 0x0f;
 }
 
 
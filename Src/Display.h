@@ -51,6 +51,17 @@ const int FULL_DISPLAY_X = 640;
 const int FULL_DISPLAY_Y = 480;
 #endif
 
+// SDL events that can wait for the emulation thread
+const int EVENT_QUEUE_SIZE = 256;
+
+// Lines of the bitmap that changed, one bit per line (see MOS6569::DirtyLines())
+const int DIRTY_WORDS = (DISPLAY_Y + 31) / 32;
+
+static inline bool LineDirty(const uint32 *dirty, int y)
+{
+	return dirty[y >> 5] & (1u << (y & 31));
+}
+
 class C64Window;
 class C64Screen;
 class C64;
@@ -64,7 +75,8 @@ public:
 
 	void Update(void);
 	void UpdateLEDs(int l0, int l1, int l2, int l3);
-	void Speedometer(int speed);
+	bool DriveLEDOn(void);
+	void Speedometer(int speed, int skip = 1);
 	void NetworkTrafficMeter(float kb_per_s, bool has_throttled);
 	uint8 *BitmapBase(void);
 	int BitmapXMod(void);
@@ -76,9 +88,9 @@ public:
 	void UpdateKeyMatrix(int c64_key, bool key_up, uint8 *key_matrix,
 			uint8 *rev_matrix, uint8 *joystick);
 	void Update(uint8 *src_pixels);
-	void Update_8(uint8 *src_pixels);
-	void Update_16(uint8 *src_pixels);
-	void Update_32(uint8 *src_pixels);
+	void Update_8(uint8 *src_pixels, const uint32 *dirty);
+	void Update_16(uint8 *src_pixels, const uint32 *dirty);
+	void Update_32(uint8 *src_pixels, const uint32 *dirty);
 	void Update_stretched(uint8 *src_pixels);
 	SDL_Surface *SurfaceFromC64Display();
 	const char *GetTextMessage();
@@ -87,10 +99,13 @@ public:
 	void NewPrefs(Prefs *prefs);
 
 	void TypeNetworkMessage(bool broadcast = false);
+	void LockGui(void);
+	void UnlockGui(void);
 
 	C64 *TheC64;
 
 	bool quit_requested;
+	bool rewind_held;		// Rewind key is down
 
 
 	/* FIXME! Should not be public */
@@ -99,7 +114,37 @@ private:
 	int led_state[4];
 	int old_led_state[4];
 
-	char speedometer_string[16];		// Speedometer text
+	static int presenter_func(void *display);
+	void present_frame(uint8 *src_pixels, const uint32 *dirty);
+	void pump_events(void);
+	bool speedometer_shown(void);
+	void hand_over(const uint32 *dirty);
+
+	// Triple buffer between the VIC and the presenter thread. The VIC
+	// draws into frame_buf[back_buf], the presenter shows frame_buf[front_buf]
+	// and the third buffer is handed over through shared_buf.
+	uint8 frame_buf[3][DISPLAY_X * DISPLAY_Y];
+	int back_buf;
+	int front_buf;
+	volatile int shared_buf;			// Buffer index | FRAME_FRESH
+	volatile bool presenter_quit;
+	SDL_Thread *presenter;
+	SDL_sem *frame_ready;				// A frame was handed over or input is wanted
+
+	// SDL events polled by the presenter thread for PollKeyboard()
+	// (protected by the input lock)
+	SDL_Event event_queue[EVENT_QUEUE_SIZE];
+	int event_count;
+
+	// Lines of each buffer that changed since the last frame the presenter
+	// took. The frames handed over after that one are collected in
+	// pending_dirty, in case the presenter skips them.
+	uint32 frame_dirty[3][DIRTY_WORDS];
+	uint32 pending_dirty[DIRTY_WORDS];
+	bool peer_frame;					// Last frame came from the network peer instead of the VIC
+	bool gui_drawn;						// Presenter: The GUI was drawn over the last frame
+
+	char speedometer_string[32];		// Speedometer text (protected by the GUI lock)
 	char networktraffic_string[80];		// Speedometer text
 	const char *text_message_send;
 };
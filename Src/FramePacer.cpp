@@ -0,0 +1,154 @@
+/*
+ *  FramePacer.cpp - Frame pacing on a monotonic nanosecond clock
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#include "sysdeps.h"
+
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(GEKKO)
+#include <ogc/lwp_watchdog.h>
+#endif
+
+#include "FramePacer.h"
+
+// Restart the schedule instead of catching up when this many frames behind
+const int MAX_FRAMES_BEHIND = 4;
+
+
+FramePacer::FramePacer()
+{
+	this->Reset();
+}
+
+
+/*
+ *  Forget the schedule and the statistics
+ */
+
+void FramePacer::Reset(void)
+{
+	deadline = last_frame = 0;
+	frames = late_frames = resyncs = 0;
+	min_ns = max_ns = 0;
+	sum_ns = sum_sq_ns = 0;
+}
+
+
+/*
+ *  Start a new schedule with the next frame, keeping the statistics
+ *  (after the emulation has run unpaced for a while)
+ */
+
+void FramePacer::Restart(void)
+{
+	deadline = 0;
+}
+
+
+/*
+ *  Monotonic time in nanoseconds
+ */
+
+uint64 FramePacer::Now(void)
+{
+#if defined(GEKKO)
+	return ticks_to_nanosecs(gettime());
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void FramePacer::sleep_until(uint64 t)
+{
+#if defined(GEKKO)
+	uint64 now = Now();
+
+	if (t > now)
+		usleep((t - now) / 1000);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = t / 1000000000;
+	ts.tv_nsec = t % 1000000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+#endif
+}
+
+
+/*
+ *  Sleep until the end of the current frame
+ */
+
+void FramePacer::Wait(uint64 period_ns)
+{
+	uint64 now = Now();
+
+	if (deadline == 0) {
+		deadline = last_frame = now;
+		return;
+	}
+
+	deadline += period_ns;
+	if (now > deadline + MAX_FRAMES_BEHIND * period_ns) {
+		// Slow host or the emulation was stopped, don't race to catch up
+		deadline = now;
+		resyncs++;
+	} else if (now < deadline) {
+		sleep_until(deadline);
+		now = Now();
+	} else
+		late_frames++;
+
+	uint64 frame_ns = now - last_frame;
+	last_frame = now;
+
+	if (frames == 0 || frame_ns < min_ns)
+		min_ns = frame_ns;
+	if (frame_ns > max_ns)
+		max_ns = frame_ns;
+	sum_ns += frame_ns;
+	sum_sq_ns += (double)frame_ns * frame_ns;
+	frames++;
+}
+
+
+/*
+ *  Host time spent on the current frame so far
+ */
+
+uint64 FramePacer::Busy(void)
+{
+	if (deadline == 0)
+		return 0;
+	return Now() - last_frame;
+}
+
+
+/*
+ *  Print frame time statistics
+ */
+
+void FramePacer::PrintStats(FILE *f)
+{
+	if (frames == 0)
+		return;
+
+	double mean = sum_ns / frames;
+	double var = sum_sq_ns / frames - mean * mean;
+
+	fprintf(f, "Frame pacing: %u frames, mean %.3f ms, stddev %.3f ms, min %.3f ms, max %.3f ms, %u late, %u resyncs\n",
+			frames, mean / 1e6, var > 0 ? sqrt(var) / 1e6 : 0.0,
+			min_ns / 1e6, max_ns / 1e6, late_frames, resyncs);
+}
@@ -0,0 +1,49 @@
+/*
+ *  FramePacer.h - Frame pacing on a monotonic nanosecond clock
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#ifndef _FRAMEPACER_H
+#define _FRAMEPACER_H
+
+#include <stdio.h>
+
+
+/*
+ *  Keeps an absolute schedule of frame deadlines instead of sleeping
+ *  for the time left of each frame, so rounding errors don't add up.
+ *  Wait() is called once per emulated frame with the current frame
+ *  period; it may change from frame to frame (audio sync).
+ */
+
+class FramePacer {
+public:
+	FramePacer();
+
+	void Reset(void);
+	void Restart(void);
+	void Wait(uint64 period_ns);
+	uint64 Busy(void);		// Time since the last Wait() returned, 0 = not started
+	void PrintStats(FILE *f);
+
+	static uint64 Now(void);
+
+private:
+	void sleep_until(uint64 t);
+
+	uint64 deadline;		// Time the current frame is due, 0 = not started
+	uint64 last_frame;		// Time the previous Wait() returned
+
+	// Frame time statistics
+	uint32 frames;
+	uint32 late_frames;		// Frames that missed their deadline
+	uint32 resyncs;			// Schedule given up after falling too far behind
+	uint64 min_ns, max_ns;
+	double sum_ns, sum_sq_ns;
+};
+
+#endif
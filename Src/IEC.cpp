@@ -97,7 +97,7 @@ Drive *IEC::create_drive(const char *path)
 	return NULL;
 }
 
-IEC::IEC(C64Display *display) : the_display(display)
+IEC::IEC(C64 *c64, C64Display *display) : TheC64(c64), the_display(display)
 {
 	int i;
 
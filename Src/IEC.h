@@ -127,13 +127,14 @@ struct c64_dir_entry {
 };
 
 class Drive;
+class C64;
 class C64Display;
 class Prefs;
 
 // Class for complete IEC bus system with drives 8..11
 class IEC {
 public:
-	IEC(C64Display *display);
+	IEC(C64 *c64, C64Display *display);
 	~IEC();
 
 	void Reset(void);
@@ -149,6 +150,8 @@ public:
 	void Turnaround(void);
 	void Release(void);
 
+	C64 *TheC64;			// Pointer to C64 object (for the 1541 ROM)
+
 private:
 	Drive *create_drive(const char *path);
 
@@ -228,7 +231,6 @@ protected:
 	uint8 cmd_buf[64];		// Buffer for incoming command strings
 	int cmd_len;			// Length of received command
 
-private:
 	IEC *the_iec;			// Pointer to IEC object
 };
 
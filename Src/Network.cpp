@@ -148,6 +148,7 @@ Network::Network(const char *remote_host, int port)
 
 	/* Assume black screen */
 	memset(this->screen, 0, DISPLAY_X * DISPLAY_Y);
+	memset(this->dirty_lines, 0xff, sizeof(this->dirty_lines));
 	memset(this->screenshot, 0, sizeof(this->screenshot));
 
 	Network::networking_started = true;
@@ -293,6 +294,25 @@ bool Network::CompareSquare(uint8 *a, uint8 *b)
 	return true;
 }
 
+bool Network::SquareDirty(int square)
+{
+	const int y_start = SQUARE_TO_Y(square);
+
+	for (int y = y_start; y < y_start + SQUARE_H; y++)
+	{
+		if (LineDirty(this->dirty_lines, y))
+			return true;
+	}
+
+	return false;
+}
+
+void Network::MarkDirty(const Uint32 *lines)
+{
+	for (int i = 0; i < DIRTY_WORDS; i++)
+		this->dirty_lines[i] |= lines[i];
+}
+
 void Network::EncodeDisplay(uint8 *master, uint8 *remote)
 {
 	for ( int sq = 0; sq < N_SQUARES_H * N_SQUARES_W; sq++ )
@@ -302,7 +322,7 @@ void Network::EncodeDisplay(uint8 *master, uint8 *remote)
 
 		/* Refresh periodically or if the squares differ */
 		if ( (this->refresh_square == sq && this->kbps < this->target_kbps * 0.7) ||
-				this->CompareSquare(p_master, p_remote) == false)
+				(this->SquareDirty(sq) && this->CompareSquare(p_master, p_remote) == false))
 		{
 			NetworkUpdate *dst = (NetworkUpdate *)this->cur_ud;
 
@@ -322,7 +342,14 @@ void Network::EncodeDisplay(uint8 *master, uint8 *remote)
 		else
 			this->square_updated[sq] = 0;
 	}
-	memcpy(remote, master, DISPLAY_X * DISPLAY_Y);
+
+	/* The other lines are the same on both sides */
+	for (int y = 0; y < DISPLAY_Y; y++)
+	{
+		if (LineDirty(this->dirty_lines, y))
+			memcpy(&remote[y * DISPLAY_X], &master[y * DISPLAY_X], DISPLAY_X);
+	}
+	memset(this->dirty_lines, 0, sizeof(this->dirty_lines));
 }
 
 
@@ -219,6 +219,14 @@ public:
 
 	void EncodeDisplay(Uint8 *master, Uint8 *remote);
 
+	/**
+	 * Note lines of the display that changed. EncodeDisplay() only
+	 * compares these with the remote screen.
+	 *
+	 * @param lines bit mask of the changed lines (see DIRTY_WORDS)
+	 */
+	void MarkDirty(const Uint32 *lines);
+
 	void EncodeJoystickUpdate(Uint8 v);
 
 	void EncodeTextMessage(const char *str, bool broadcast = false);
@@ -358,6 +366,15 @@ protected:
 	 */
 	bool CompareSquare(Uint8 *a, Uint8 *b);
 
+	/**
+	 * Check if any line of a display square has changed
+	 *
+	 * @param square the square number
+	 *
+	 * @return true if a line is marked dirty
+	 */
+	bool SquareDirty(int square);
+
 	bool DecodeDisplayDiff(struct NetworkUpdate *src,
 			int x, int y);
 	bool DecodeDisplayRLE(struct NetworkUpdate *src,
@@ -426,6 +443,7 @@ protected:
 	int refresh_square;
 
 	Uint8 *screen;
+	Uint32 dirty_lines[DIRTY_WORDS]; /* Changed since the last EncodeDisplay() */
 	int joystick_port;
 	bool connected;
 	Uint8 cur_joystick_data;
@@ -114,6 +114,13 @@ Prefs::Prefs()
 	this->SetupJoystickDefaults();
 
 	this->MsPerFrame = SPEED_100;
+	this->AudioSync = false;
+	this->AutoWarp = true;
+	this->AutoSkip = false;
+	this->ShowSpeed = false;
+	this->RewindMemory = 8192;
+	this->RunAhead = 0;
+	this->RenderThreads = 0;
 	this->NetworkKey = rand() % 0xffff;
 	this->NetworkAvatar = 0;
 	snprintf(this->NetworkName, 32, "Unset name");
@@ -322,6 +329,13 @@ bool Prefs::operator==(const Prefs &rhs) const
 		&& Port == rhs.Port
 		&& Rumble == rhs.Rumble
 		&& this->MsPerFrame == rhs.MsPerFrame
+		&& this->AudioSync == rhs.AudioSync
+		&& this->AutoWarp == rhs.AutoWarp
+		&& this->AutoSkip == rhs.AutoSkip
+		&& this->ShowSpeed == rhs.ShowSpeed
+		&& this->RewindMemory == rhs.RewindMemory
+		&& this->RunAhead == rhs.RunAhead
+		&& this->RenderThreads == rhs.RenderThreads
 		&& this->NetworkKey == rhs.NetworkKey
 		&& this->NetworkPort == rhs.NetworkPort
 		&& this->NetworkRegion == rhs.NetworkRegion
@@ -522,6 +536,20 @@ void Prefs::Load(const char *filename)
 				}
 				else if (!strcmp(keyword, "MsPerFrame"))
 					MsPerFrame = atoi(value);
+				else if (!strcmp(keyword, "AudioSync"))
+					AudioSync = !strcmp(value, "TRUE");
+				else if (!strcmp(keyword, "AutoWarp"))
+					AutoWarp = !strcmp(value, "TRUE");
+				else if (!strcmp(keyword, "AutoSkip"))
+					AutoSkip = !strcmp(value, "TRUE");
+				else if (!strcmp(keyword, "ShowSpeed"))
+					ShowSpeed = !strcmp(value, "TRUE");
+				else if (!strcmp(keyword, "RewindMemory"))
+					RewindMemory = atoi(value);
+				else if (!strcmp(keyword, "RunAhead"))
+					RunAhead = atoi(value);
+				else if (!strcmp(keyword, "RenderThreads"))
+					RenderThreads = atoi(value);
 				else if (!strcmp(keyword, "NetworkKey"))
 					NetworkKey = atoi(value);
 				else if (!strcmp(keyword, "NetworkName"))
@@ -660,6 +688,13 @@ bool Prefs::Save(const char *filename)
 		}
 
 		maybe_write(file, MsPerFrame != TheDefaultPrefs.MsPerFrame, "MsPerFrame = %d\n", MsPerFrame);
+		maybe_write(file, AudioSync != TheDefaultPrefs.AudioSync, "AudioSync = %s\n", AudioSync ? "TRUE" : "FALSE");
+		maybe_write(file, AutoWarp != TheDefaultPrefs.AutoWarp, "AutoWarp = %s\n", AutoWarp ? "TRUE" : "FALSE");
+		maybe_write(file, AutoSkip != TheDefaultPrefs.AutoSkip, "AutoSkip = %s\n", AutoSkip ? "TRUE" : "FALSE");
+		maybe_write(file, ShowSpeed != TheDefaultPrefs.ShowSpeed, "ShowSpeed = %s\n", ShowSpeed ? "TRUE" : "FALSE");
+		maybe_write(file, RewindMemory != TheDefaultPrefs.RewindMemory, "RewindMemory = %d\n", RewindMemory);
+		maybe_write(file, RunAhead != TheDefaultPrefs.RunAhead, "RunAhead = %d\n", RunAhead);
+		maybe_write(file, RenderThreads != TheDefaultPrefs.RenderThreads, "RenderThreads = %d\n", RenderThreads);
 		maybe_write(file, NetworkKey != TheDefaultPrefs.NetworkKey, "NetworkKey = %d\n", NetworkKey);
 		maybe_write(file, NetworkAvatar != TheDefaultPrefs.NetworkAvatar, "NetworkAvatar = %d\n", NetworkAvatar);
 		maybe_write(file, strcmp(NetworkName, TheDefaultPrefs.NetworkName) != 0, "NetworkName = %s\n", NetworkName);
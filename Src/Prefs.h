@@ -164,6 +164,13 @@ public:
 	bool Rumble;			// Enable Rumble for WII
 
 	uint32 MsPerFrame;
+	bool AudioSync;			// Pace frames by the sound buffer instead of MsPerFrame
+	bool AutoWarp;			// Run at full speed while loading
+	bool AutoSkip;			// Skip more frames (up to a limit) when the host is too slow, SkipFrames is the least
+	bool ShowSpeed;			// Show the speedometer
+	int RewindMemory;		// Size of the rewind buffer in KB, 0 = off
+	int RunAhead;			// Frames to run ahead of the input, 0 = off (SC only)
+	int RenderThreads;		// Threads drawing the lines of the frame, 0 = on the emulation thread (SL only)
 
 	int JoystickAxes[MAX_JOYSTICK_AXES];
 	int JoystickHats[MAX_JOYSTICK_HATS];
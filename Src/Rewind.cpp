@@ -0,0 +1,241 @@
+/*
+ *  Rewind.cpp - Ring buffer of the last emulated frames
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#include "sysdeps.h"
+
+#include "Rewind.h"
+#include "C64.h"
+
+// Every n-th frame is a keyframe (one per second)
+const uint32 REWIND_KEY_INTERVAL = 50;
+
+// Smallest frame that is expected in the ring, for sizing the index
+const uint32 REWIND_MIN_FRAME = 256;
+
+
+RewindBuffer::RewindBuffer(C64 *c64, size_t max_bytes) : the_c64(c64)
+{
+	words = (c64->SnapshotSize() + 3) / 4;
+	cur = (uint32 *)calloc(words, 4);
+	key_arena = (uint32 *)calloc(words, 4);
+	zero = (uint32 *)calloc(words, 4);
+
+	// A frame encodes to at most three words more than the arena,
+	// make sure that two of them fit
+	enc = (uint32 *)malloc((words + 3) * 4);
+	ring_size = max_bytes;
+	if (ring_size < (words + 3) * 8)
+		ring_size = (words + 3) * 8;
+	ring = (uint8 *)malloc(ring_size);
+
+	max_frames = ring_size / REWIND_MIN_FRAME;
+	frames = new Frame[max_frames];
+
+	Clear();
+}
+
+RewindBuffer::~RewindBuffer()
+{
+	delete[] frames;
+	free(ring);
+	free(enc);
+	free(zero);
+	free(key_arena);
+	free(cur);
+}
+
+
+/*
+ *  Forget all frames
+ */
+
+void RewindBuffer::Clear(void)
+{
+	first_seq = next_seq = 0;
+	head = 0;
+	key_valid = false;
+	restored = false;
+}
+
+int RewindBuffer::Frames(void)
+{
+	return next_seq - first_seq;
+}
+
+
+/*
+ *  Save the current state of the C64. The arena is captured incrementally,
+ *  so only the RAM pages written since the last frame are copied.
+ */
+
+void RewindBuffer::Capture(void)
+{
+	uint32 size;
+
+	the_c64->CaptureSnapshot(cur);
+	restored = false;
+
+	if (first_seq != next_seq && key_valid && next_seq - key_seq < REWIND_KEY_INTERVAL) {
+		size = encode(key_arena);
+		if (store(size, key_seq))
+			return;
+		// Its keyframe had to make room, save a new one
+	}
+
+	size = encode(zero);
+	store(size, next_seq);
+	memcpy(key_arena, cur, words * 4);
+	key_seq = next_seq - 1;
+	key_valid = true;
+}
+
+
+/*
+ *  Go back to the newest frame. It stays in the buffer until the next
+ *  call, so that saving continues without a gap when rewinding stops.
+ *  The oldest frame is restored again and again.
+ */
+
+bool RewindBuffer::Rewind(void)
+{
+	if (restored && next_seq - first_seq > 1)
+		drop_newest();
+	if (first_seq == next_seq)
+		return false;
+
+	uint32 seq = next_seq - 1;
+	Frame *f = frame(seq);
+
+	if (f->key == seq)
+		decode(f, zero, cur);
+	else {
+		if (!key_valid || key_seq != f->key) {
+			decode(frame(f->key), zero, key_arena);
+			key_seq = f->key;
+			key_valid = true;
+		}
+		decode(f, key_arena, cur);
+	}
+
+	restored = true;
+	return the_c64->RestoreSnapshot(cur);
+}
+
+
+/*
+ *  Run-length encode the current arena XORed with base into enc[]:
+ *  A number of words equal to base, a number of differing words and
+ *  these words XORed with base, repeated. Single equal words don't end
+ *  a run of differing ones. Returns the size in bytes.
+ */
+
+uint32 RewindBuffer::encode(const uint32 *base)
+{
+	uint32 *out = enc;
+	uint32 i = 0;
+
+	while (i < words) {
+		uint32 start = i;
+		while (i < words && cur[i] == base[i])
+			i++;
+		*out++ = i - start;
+
+		uint32 *len = out++;
+		start = i;
+		while (i < words && (cur[i] != base[i] || (i + 1 < words && cur[i + 1] != base[i + 1]))) {
+			*out++ = cur[i] ^ base[i];
+			i++;
+		}
+		*len = i - start;
+	}
+	return (out - enc) * 4;
+}
+
+
+/*
+ *  Decode frame f XORed with base into out[]
+ */
+
+void RewindBuffer::decode(const Frame *f, const uint32 *base, uint32 *out)
+{
+	const uint32 *in = (const uint32 *)(ring + f->offset);
+	const uint32 *end = in + f->size / 4;
+	uint32 i = 0;
+
+	while (in < end) {
+		uint32 n = *in++;
+		memcpy(out + i, base + i, n * 4);
+		i += n;
+
+		for (n = *in++; n; n--, i++)
+			out[i] = *in++ ^ base[i];
+	}
+}
+
+
+/*
+ *  Append enc[] to the ring as the frame after the newest one, dropping
+ *  old frames as needed. Frames are never split; if one doesn't fit
+ *  between head and the end of the ring, it goes to the start and the
+ *  frames still at the end are dropped. Returns false if this dropped
+ *  its keyframe.
+ */
+
+bool RewindBuffer::store(uint32 size, uint32 key)
+{
+	if (next_seq - first_seq == max_frames)
+		drop_oldest();
+
+	if (head + size > ring_size) {
+		while (first_seq != next_seq && frame(first_seq)->offset >= head)
+			drop_oldest();
+		head = 0;
+	}
+	while (first_seq != next_seq && frame(first_seq)->offset >= head &&
+			frame(first_seq)->offset < head + size)
+		drop_oldest();
+
+	// Dropping its keyframe also dropped every frame after it
+	if (key != next_seq && first_seq == next_seq)
+		return false;
+
+	Frame *f = frame(next_seq);
+	f->offset = head;
+	f->size = size;
+	f->key = key;
+	memcpy(ring + head, enc, size);
+	head += size;
+	next_seq++;
+	return true;
+}
+
+
+/*
+ *  Drop the newest frame, it always ends at head
+ */
+
+void RewindBuffer::drop_newest(void)
+{
+	next_seq--;
+	head = frame(next_seq)->offset;
+	if (key_seq == next_seq)
+		key_valid = false;
+}
+
+
+/*
+ *  Drop the oldest keyframe and the frames depending on it
+ */
+
+void RewindBuffer::drop_oldest(void)
+{
+	do {
+		first_seq++;
+	} while (first_seq != next_seq && frame(first_seq)->key != first_seq);
+}
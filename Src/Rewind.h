@@ -0,0 +1,71 @@
+/*
+ *  Rewind.h - Ring buffer of the last emulated frames
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#ifndef _REWIND_H
+#define _REWIND_H
+
+class C64;
+
+
+/*
+ *  Saves an in-memory snapshot of the C64 in every VBlank and keeps as
+ *  many of them as fit into a fixed amount of memory. Every
+ *  REWIND_KEY_INTERVAL-th frame is a keyframe, the others are stored as
+ *  their difference to the keyframe before them. Both are XORed (the
+ *  keyframes with zero) and run-length encoded. When the memory is full,
+ *  the oldest keyframe is dropped together with the frames depending
+ *  on it.
+ */
+
+class RewindBuffer {
+public:
+	RewindBuffer(C64 *c64, size_t max_bytes);
+	~RewindBuffer();
+
+	void Clear(void);
+	void Capture(void);		// Save the frame (in VBlank)
+	bool Rewind(void);		// Go back one frame (in VBlank)
+	int Frames(void);		// Number of frames that can be rewound
+
+private:
+	struct Frame {
+		uint32 offset;		// Position of the encoded frame in ring[]
+		uint32 size;		// Length in bytes
+		uint32 key;			// Sequence number of its keyframe
+	};
+
+	Frame *frame(uint32 seq) { return &frames[seq % max_frames]; }
+	uint32 encode(const uint32 *base);
+	void decode(const Frame *f, const uint32 *base, uint32 *out);
+	bool store(uint32 size, uint32 key);
+	void drop_oldest(void);
+	void drop_newest(void);
+
+	C64 *the_c64;
+
+	uint32 words;			// Size of a snapshot arena in 32 bit words
+	uint32 *cur;			// Arena of the last saved or restored frame
+	uint32 *key_arena;		// Decoded keyframe key_seq (if key_valid)
+	uint32 *zero;			// All zero arena the keyframes are encoded against
+	uint32 *enc;			// Frame being encoded
+	uint32 key_seq;
+	bool key_valid;
+	bool restored;			// Emulation went on from the newest frame after restoring it
+
+	uint8 *ring;			// Encoded frames
+	uint32 ring_size;
+	uint32 head;			// Where the next frame goes in ring[]
+
+	Frame *frames;			// Index of the frames in ring[], by sequence number
+	uint32 max_frames;
+	uint32 first_seq;		// Oldest frame
+	uint32 next_seq;		// Frame after the newest
+};
+
+#endif
@@ -57,24 +57,17 @@
  *  Random number generator for noise waveform
  */
 
-static uint8 sid_random(void);
-static uint8 sid_random(void)
-{
-	static uint32 seed = 1;
-	seed = seed * 1103515245 + 12345;
-	return seed >> 16;
-}
-
-
 /*
  *  Constructor
  */
 
 MOS6581::MOS6581(C64 *c64) : the_c64(c64)
 {
-	the_renderer = NULL;
+	the_renderer = held_renderer = NULL;
+	net_sound = NULL;
 	for (int i=0; i<32; i++)
 		regs[i] = 0;
+	osc3_random = 0;
 
 	// Open the renderer
 	open_close_renderer(SIDTYPE_NONE, ThePrefs.SIDType);
@@ -101,6 +94,7 @@ void MOS6581::Reset(void)
 	for (int i=0; i<32; i++)
 		regs[i] = 0;
 	last_sid_byte = 0;
+	osc3_random = rand();
 
 	// Reset the renderer
 	if (the_renderer != NULL)
@@ -226,6 +220,42 @@ void MOS6581::SetState(MOS6581State *ss)
 }
 
 
+/*
+ *  Get/restore the SID state that is not in MOS6581State
+ */
+
+void MOS6581::GetBusState(MOS6581BusState *ss)
+{
+	ss->last_sid_byte = last_sid_byte;
+	ss->osc3_random = osc3_random;
+}
+
+void MOS6581::SetBusState(MOS6581BusState *ss)
+{
+	last_sid_byte = ss->last_sid_byte;
+	osc3_random = ss->osc3_random;
+}
+
+
+/*
+ *  Detach the renderer while frames are run ahead of the input, so that
+ *  the sound only comes from the real timeline. It doesn't see the
+ *  register writes of these frames either; SetState() writes the
+ *  registers again when the emulation goes back.
+ */
+
+void MOS6581::HoldRenderer(bool hold)
+{
+	if (hold) {
+		held_renderer = the_renderer;
+		the_renderer = NULL;
+	} else {
+		the_renderer = held_renderer;
+		held_renderer = NULL;
+	}
+}
+
+
 /**
  **  Renderer for digital SID emulation (SIDTYPE_DIGITAL)
  **/
@@ -304,7 +334,7 @@ struct DRVoice {
 // Renderer class
 class DigitalRenderer : public SIDRenderer {
 public:
-	DigitalRenderer();
+	DigitalRenderer(C64 *c64);
 	virtual ~DigitalRenderer();
 
 	virtual void Reset(void);
@@ -314,13 +344,23 @@ public:
 	virtual void NewPrefs(Prefs *prefs);
 	virtual void Pause(void);
 	virtual void Resume(void);
+	virtual uint32 OutputHash(void) { return output_hash; }
+
+#if !defined(GEKKO)
+	virtual int BufferFill(void);
+	void fill_audio(uint8 *stream, int len);
+#endif
 
 private:
 	void init_sound(void);
 	void calc_filter(void);
 	void calc_buffer(int16 *buf, long count);
+	uint8 sid_random(void);
 
+	C64 *the_c64;					// Pointer to C64 object
 	bool ready;						// Flag: Renderer has initialized and is ready
+	uint32 output_hash;				// FNV-1a hash of all calculated samples
+	uint32 noise_seed;				// Random generator for the noise waveform
 	uint8 volume;					// Master volume
 
 	static uint16 TriTable[0x1000*2];	// Tables for certain waveforms
@@ -362,6 +402,10 @@ private:
 #if defined(__linux__) || defined(GEKKO)
 	int devfd, sndbufsize, buffer_rate;
 	int16 *sound_buffer;
+	int divisor, to_output;			// Samples due for the current line
+#endif
+#if !defined(GEKKO)
+	int head, tail;					// Ring of buffers in sound_buffer
 #endif
 };
 
@@ -692,11 +736,7 @@ const int16 DigitalRenderer::SampleTab[16] = {
  *  Constructor
  */
 
-#if defined(__BEOS__) || defined(__riscos__)
 DigitalRenderer::DigitalRenderer(C64 *c64) : the_c64(c64)
-#else
-DigitalRenderer::DigitalRenderer()
-#endif
 {
 	// Link voices together
 	voice[0].mod_by = &voice[2];
@@ -733,6 +773,13 @@ DigitalRenderer::DigitalRenderer()
 
 	Reset();
 
+	output_hash = 2166136261U;
+	noise_seed = 1;
+#if defined(__linux__) || defined(GEKKO)
+	sound_buffer = NULL;
+	divisor = to_output = 0;
+#endif
+
 	// System specific initialization
 	init_sound();
 }
@@ -779,7 +826,6 @@ void DigitalRenderer::Reset(void)
  */
 
 #include "C64.h"
-extern C64 *TheC64;
 /*
  * Fill buffer (for Unix sound routines), sample volume (for sampled voice)
  */
@@ -789,12 +835,12 @@ void MOS6581::EmulateLine(void)
 	if (the_renderer != NULL)
 		the_renderer->EmulateLine();
 	/* Flush network sound every ~100ms */
-	if (TheC64->network_connection_type == CLIENT)
+	if (the_c64->network_connection_type == CLIENT)
 	{
-		static NetworkUpdateSoundInfo *cur = NULL;
+		NetworkUpdateSoundInfo *cur = this->net_sound;
 
 		if (!cur) {
-			cur = TheC64->network->DequeueSound();
+			cur = the_c64->network->DequeueSound();
 		}
 
 		while (cur) {
@@ -804,12 +850,13 @@ void MOS6581::EmulateLine(void)
 				break;
 			/* Delayed long enough - write to the SID! */
 			this->WriteRegister(cur->adr, cur->val);
-			cur = TheC64->network->DequeueSound();
+			cur = the_c64->network->DequeueSound();
 		}
+		this->net_sound = cur;
 	}
-	if (TheC64->network_connection_type == MASTER ||
-			TheC64->network_connection_type == CLIENT)
-		TheC64->linecnt++;
+	if (the_c64->network_connection_type == MASTER ||
+			the_c64->network_connection_type == CLIENT)
+		the_c64->linecnt++;
 }
 
 void DigitalRenderer::WriteRegister(uint16 adr, uint8 byte)
@@ -817,10 +864,8 @@ void DigitalRenderer::WriteRegister(uint16 adr, uint8 byte)
 	if (!ready)
 		return;
 
-	if (TheC64) {
-		if (TheC64->network_connection_type == MASTER)
-			TheC64->network->RegisterSidWrite(TheC64->linecnt, adr, byte);
-	}
+	if (the_c64->network_connection_type == MASTER)
+		the_c64->network->RegisterSidWrite(the_c64->linecnt, adr, byte);
 
 	int v = adr/7;	// Voice number
 
@@ -1083,6 +1128,17 @@ void DigitalRenderer::calc_filter(void)
 }
 
 
+/*
+ *  Pseudo random numbers for the noise waveform
+ */
+
+uint8 DigitalRenderer::sid_random(void)
+{
+	noise_seed = noise_seed * 1103515245 + 12345;
+	return noise_seed >> 16;
+}
+
+
 /*
  *  Fill one audio buffer with calculated SID sound
  */
@@ -1232,10 +1288,11 @@ void DigitalRenderer::calc_buffer(int16 *buf, long count)
 
 		// Write to buffer
 #if defined(__riscos__)	// lookup in 8k (13bit) translation table
-		*buf++ = LinToLog[((sum_output + sum_output_filter) >> 13) & 0x1fff];
+		*buf = LinToLog[((sum_output + sum_output_filter) >> 13) & 0x1fff];
 #else
-		*buf++ = (sum_output + sum_output_filter) >> 10;
+		*buf = (sum_output + sum_output_filter) >> 10;
 #endif
+		output_hash = (output_hash ^ (uint16)*buf++) * 16777619;
 	}
 }
 
@@ -1262,7 +1319,7 @@ void MOS6581::open_close_renderer(int old_type, int new_type)
 
 	// Create new renderer
 	if (new_type == SIDTYPE_DIGITAL)
-		the_renderer = new DigitalRenderer;
+		the_renderer = new DigitalRenderer(the_c64);
 	else
 		the_renderer = NULL;
 
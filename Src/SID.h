@@ -33,6 +33,8 @@ class Prefs;
 class C64;
 class SIDRenderer;
 struct MOS6581State;
+struct MOS6581BusState;
+struct NetworkUpdateSoundInfo;
 
 // Class for administrative functions
 class MOS6581 {
@@ -48,8 +50,13 @@ public:
 	void ResumeSound(void);
 	void GetState(MOS6581State *ss);
 	void SetState(MOS6581State *ss);
+	void GetBusState(MOS6581BusState *ss);
+	void SetBusState(MOS6581BusState *ss);
+	void HoldRenderer(bool hold);	// Keep the renderer out of the frames run ahead
 	void EmulateLine(void);
 	void PushVolume(uint8); /* For the network */
+	uint32 OutputHash(void);	// Hash of the sound output so far
+	int BufferFill(void);		// Sound buffer fill level in percent, -1 if unknown
 
 private:
 	void open_close_renderer(int old_type, int new_type);
@@ -58,6 +65,9 @@ private:
 	SIDRenderer *the_renderer;	// Pointer to current renderer
 	uint8 regs[32];				// Copies of the 25 write-only SID registers
 	uint8 last_sid_byte;		// Last value written to SID
+	uint32 osc3_random;			// Generator for the voice 3 oscillator/EG readout
+	SIDRenderer *held_renderer;	// Renderer while held
+	NetworkUpdateSoundInfo *net_sound;	// Sound update from the network waiting to be played
 };
 
 
@@ -72,6 +82,8 @@ public:
 	virtual void NewPrefs(Prefs *prefs)=0;
 	virtual void Pause(void)=0;
 	virtual void Resume(void)=0;
+	virtual uint32 OutputHash(void) { return 0; }
+	virtual int BufferFill(void) { return -1; }
 };
 
 
@@ -112,6 +124,12 @@ struct MOS6581State {
 	uint8 env_3;
 };
 
+// SID state that is not part of MOS6581State (and of the snapshot files)
+struct MOS6581BusState {
+	uint8 last_sid_byte;
+	uint32 osc3_random;
+};
+
 
 inline void MOS6581::PushVolume(uint8 vol)
 {
@@ -119,6 +137,16 @@ inline void MOS6581::PushVolume(uint8 vol)
 		the_renderer->PushVolume(vol);
 }
 
+inline uint32 MOS6581::OutputHash(void)
+{
+	return the_renderer != NULL ? the_renderer->OutputHash() : 0;
+}
+
+inline int MOS6581::BufferFill(void)
+{
+	return the_renderer != NULL ? the_renderer->BufferFill() : -1;
+}
+
 /*
  *  Read from register
  */
@@ -134,7 +162,8 @@ inline uint8 MOS6581::ReadRegister(uint16 adr)
 	// Voice 3 oscillator/EG readout
 	if (adr == 0x1b || adr == 0x1c) {
 		last_sid_byte = 0;
-		return rand();
+		osc3_random = osc3_random * 1103515245 + 12345;
+		return osc3_random >> 16;
 	}
 
 	// Write-only register: Return last value written to SID
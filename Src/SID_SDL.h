@@ -25,6 +25,7 @@
 #include <SDL.h>
 
 #include "VIC.h"
+#include "main.h"
 
 static SDL_AudioSpec spec;
 
@@ -32,10 +33,12 @@ static SDL_AudioSpec spec;
 #define SOUNDBUFSIZE 1536
 #define N_BUFS 8
 
-static int16 soundbuffer[N_BUFS][FRODO_SNDBUF];
-static int head, tail;
+static void fill_audio_callback(void *udata, Uint8 *stream, int len)
+{
+	((DigitalRenderer *)udata)->fill_audio(stream, len);
+}
 
-static void fill_audio(void *udata, Uint8 *stream, int len)
+void DigitalRenderer::fill_audio(uint8 *stream, int len)
 {
 	const int sz = FRODO_SNDBUF * 2;
 	int off = 0;
@@ -44,7 +47,7 @@ static void fill_audio(void *udata, Uint8 *stream, int len)
 	while (tail != head)
 	{
 		//printf("Copying %d bytes at off %d, tail %d, head %d\n", len, off, tail, head);
-		memcpy(stream + off, soundbuffer[tail], sz);
+		memcpy(stream + off, sound_buffer + tail * FRODO_SNDBUF, sz);
 		off += sz;
 		if (off >= len)
 			break;
@@ -52,6 +55,25 @@ static void fill_audio(void *udata, Uint8 *stream, int len)
 	}
 }
 
+/*
+ *  How many of the buffers are waiting to be played, for audio sync
+ */
+
+int DigitalRenderer::BufferFill(void)
+{
+	int n;
+
+	if (!ready || HeadlessMode)
+		return -1;
+
+	SDL_LockAudio();
+	n = (head - tail + N_BUFS) % N_BUFS;
+	SDL_UnlockAudio();
+
+	return n * 100 / (N_BUFS - 1);
+}
+
+
 /*
  *  Initialization
  */
@@ -65,19 +87,22 @@ void DigitalRenderer::init_sound(void)
 	spec.format = AUDIO_S16SYS;
 	spec.channels = 1;    /* 1 = mono, 2 = stereo */
 	spec.samples = SOUNDBUFSIZE;
-	spec.callback = fill_audio;
+	spec.callback = fill_audio_callback;
 	spec.userdata = (void*)this;
 
 	ready = false;
-	if ( SDL_OpenAudio(&spec, NULL) < 0 ) {
+	/* Headless: still render into soundbuffer, nobody plays it */
+	if (!HeadlessMode && SDL_OpenAudio(&spec, NULL) < 0 ) {
 		fprintf(stderr, "Couldn't open audio: %s\n", SDL_GetError());
 		return ;
 	}
 
-	this->sound_buffer = new int16[this->sndbufsize];
-	memset(this->sound_buffer, 0, sizeof(int16) * this->sndbufsize);
+	this->sound_buffer = new int16[N_BUFS * FRODO_SNDBUF];
+	memset(this->sound_buffer, 0, sizeof(int16) * N_BUFS * FRODO_SNDBUF);
+	head = tail = 0;
 	ready = true;
-	SDL_PauseAudio(0);
+	if (!HeadlessMode)
+		SDL_PauseAudio(0);
 }
 
 
@@ -87,7 +112,9 @@ void DigitalRenderer::init_sound(void)
 
 DigitalRenderer::~DigitalRenderer()
 {
-	SDL_CloseAudio();
+	if (!HeadlessMode)
+		SDL_CloseAudio();
+	delete[] sound_buffer;
 }
 
 
@@ -107,6 +134,10 @@ void DigitalRenderer::Pause(void)
 
 void DigitalRenderer::Resume(void)
 {
+	// Drop what was rendered while paused or warping
+	SDL_LockAudio();
+	tail = head;
+	SDL_UnlockAudio();
 	SDL_PauseAudio(0);
 }
 
@@ -117,9 +148,6 @@ void DigitalRenderer::Resume(void)
 
 void DigitalRenderer::PushVolume(uint8 vol)
 {
-	static int divisor = 0;
-	static int to_output = 0;
-
 	sample_buf[sample_in_ptr] = volume;
 	sample_in_ptr = (sample_in_ptr + 1) % SAMPLE_BUF_SIZE;
 
@@ -138,7 +166,7 @@ void DigitalRenderer::PushVolume(uint8 vol)
 		to_output -= datalen;
 
 		SDL_LockAudio();
-		calc_buffer(soundbuffer[head], datalen * 2);
+		calc_buffer(sound_buffer + head * FRODO_SNDBUF, datalen * 2);
 		head = (head + 1) % N_BUFS;
 		if (head == tail) {
 			tail = (head + 1) % N_BUFS;
@@ -64,9 +64,6 @@ void DigitalRenderer::Resume(void)
 
 void DigitalRenderer::PushVolume(uint8 volume)
 {
-	static int divisor = 0;
-	static int to_output = 0;
-
 	sample_buf[sample_in_ptr] = volume;
 	sample_in_ptr = (sample_in_ptr + 1) % SAMPLE_BUF_SIZE;
 
@@ -92,7 +89,7 @@ void DigitalRenderer::PushVolume(uint8 volume)
 
 void DigitalRenderer::EmulateLine(void)
 {
-	if (!ready || TheC64->IsPaused())
+	if (!ready || the_c64->IsPaused())
 		return;
 	this->PushVolume(volume);
 }
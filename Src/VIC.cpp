@@ -35,9 +35,15 @@
  *    to a bitplane representation (two bit masks) for easier
  *    handling of priorities and collisions.
  *  - The sprite-sprite priority handling and collision
- *    detection is done in with the byte array spr_coll_buf[],
- *    that is used to keep track of which sprites are already
- *    visible at certain X positions.
+ *    detection is done with the same bit planes, each sprite
+ *    is compared with the sprites with lower numbers near it.
+ *  - Every line is first recorded: The graphics data and the
+ *    registers needed to draw it are fetched, and the sprite
+ *    collisions are detected, so the emulation sees everything
+ *    at the same time as before. Drawing the recorded line is a
+ *    separate step that either follows at once, or is done by
+ *    the render threads (RenderThreads preference) while the
+ *    emulation goes on, until the frame is handed over in VBlank.
  *
  * Incompatibilities:
  * ------------------
@@ -58,6 +64,7 @@
 #include "sysdeps.h"
 
 #include "VIC.h"
+#include "VIC_expand.h"
 #include "C64.h"
 #include "CPUC64.h"
 #include "Display.h"
@@ -96,6 +103,42 @@ const int COL38_XSTART = 0x27;
 const int COL38_XSTOP = 0x157;
 #endif
 
+// Kinds of recorded lines: Display modes are 0..7, in idle state + LINE_IDLE
+const int LINE_IDLE = 8;
+const int LINE_BORDER = 16;
+
+// The render threads get the lines in batches of this many (a power of 2
+// not above 32, so the changed lines of a batch are in one word)
+const int RENDER_BATCH = 8;
+
+
+/*
+ *  Everything needed to draw a line, recorded by EmulateLine()
+ */
+
+struct VICLine {
+	uint8 *p;					// Start of the line in the bitmap
+	int mode;					// Display mode, LINE_IDLE or LINE_BORDER
+	uint16 x_scroll;			// X scroll value
+	bool border_40_col;			// Flag: 40 column border
+
+	uint8 ec_color, b0c_color, b1c_color, b2c_color;	// Indices for exterior/background colors
+	uint8 bc[4];				// Background colors (b0c..b3c)
+	uint16 mc_color_lookup[4];
+
+	uint8 gfx[40];				// Graphics data
+	const uint8 *matrix;		// Video line
+	const uint8 *color;			// Color line
+	uint8 matrix_buf[40];		// Their copies for the render threads
+	uint8 color_buf[40];
+
+	uint8 spr_lines;			// Sprites that have pixels in this line
+	uint8 spr_color[8];			// Their indices for MOB colors
+	uint8 mm0_color, mm1_color;	// Indices for MOB multicolors
+	int spr_x[8];				// Their position in the line
+	uint64 spr_plane0[8], spr_plane1[8];	// and bit planes (first pixel in the MSB), without the hidden pixels
+};
+
 
 // Tables for sprite X expansion
 uint16 ExpTable[256] = {
@@ -186,9 +229,7 @@ static union {
 
 #ifdef GLOBAL_VARS
 static uint16 mc_color_lookup[4];
-#ifndef CAN_ACCESS_UNALIGNED
 static uint8 text_chunky_buf[40*8];
-#endif
 static uint16 mx[8];						// VIC registers
 static uint8 mx8;
 static uint8 my[8];
@@ -217,9 +258,6 @@ static uint32 ec_color_long;			// ec_color expanded to 32 bits
 static uint8 matrix_line[40];			// Buffer for video line, read in Bad Lines
 static uint8 color_line[40];			// Buffer for color line, read in Bad Lines
 
-#ifdef __POWERPC__
-static double chunky_tmp[DISPLAY_X/8];	// Temporary line buffer for GameKit speedup
-#endif
 static uint8 *chunky_line_start;		// Pointer to start of current line in bitmap buffer
 static int xmod;						// Number of bytes per row
 
@@ -244,7 +282,6 @@ static int skip_counter;				// Counter for frame-skipping
 static uint16 mc[8];					// Sprite data counters
 static uint8 sprite_on;					// 8 Flags: Sprite display/DMA active
 
-static uint8 spr_coll_buf[0x180];		// Buffer for sprite-sprite collisions and priorities
 static uint8 fore_mask_buf[0x180/8];	// Foreground mask for sprite-graphics collisions and priorities
 
 static bool display_state;				// true: Display state, false: Idle state
@@ -253,6 +290,22 @@ static bool border_40_col;				// Flag: 40 column border
 static bool frame_skipped;				// Flag: Frame is being skipped
 static uint8 bad_lines_enabled;		// Flag: Bad Lines enabled for this frame
 static bool lp_triggered;				// Flag: Lightpen was triggered in this frame
+
+static uint32 dirty_lines[DIRTY_WORDS];	// Changed lines, one bit per line
+static uint8 last_frame[DISPLAY_X*DISPLAY_Y];	// Last drawn contents of all lines
+
+static VICLine lines[DISPLAY_Y];		// Recorded lines of the current frame
+
+static int render_threads;				// Render threads, see render_setup()
+static SDL_Thread *render_thread[MAX_RENDER_THREADS];
+static SDL_mutex *render_lock;
+static SDL_cond *render_cond;			// Signalled when lines are queued or drawn
+static bool render_quit;
+static int lines_queued;				// Lines the threads may draw
+static int lines_taken;					// Lines a thread has started
+static int lines_done;					// Lines that are drawn
+static void render_setup(int threads);
+static void render_wait(void);
 #endif
 
 
@@ -344,6 +397,18 @@ MOS6569::MOS6569(C64 *c64, C64Display *disp, MOS6510 *CPU, uint8 *RAM, uint8 *Ch
 	// Clear foreground mask
 	memset(fore_mask_buf, 0, DISPLAY_X/8);
 
+	memset(last_frame, 0, sizeof(last_frame));
+	memset(dirty_lines, 0xff, sizeof(dirty_lines));
+
+	// The render threads are started in VBlank
+#ifndef GLOBAL_VARS
+	lines = new VICLine[DISPLAY_Y];
+#endif
+	render_threads = 0;
+	render_lock = NULL;
+	render_cond = NULL;
+	lines_queued = lines_taken = lines_done = 0;
+
 	// Preset colors to black
 	disp->InitColors(colors);
 	init_text_color_table(colors);
@@ -353,6 +418,23 @@ MOS6569::MOS6569(C64 *c64, C64Display *disp, MOS6510 *CPU, uint8 *RAM, uint8 *Ch
 }
 
 
+/*
+ *  Destructor: End render threads
+ */
+
+MOS6569::~MOS6569()
+{
+	render_setup(0);
+	if (render_cond)
+		SDL_DestroyCond(render_cond);
+	if (render_lock)
+		SDL_DestroyMutex(render_lock);
+#ifndef GLOBAL_VARS
+	delete[] lines;
+#endif
+}
+
+
 /*
  *  Reinitialize the colors table for when the palette has changed
  */
@@ -429,6 +511,49 @@ inline uint8 *MOS6569::get_physical(uint16 adr)
 }
 
 
+/*
+ *  Changed lines: Every drawn line is compared with the same line of the
+ *  last drawn frame when it is finished. This catches all changes, also
+ *  those from raster effects, and costs much less than drawing the line.
+ *  The bits collect until the display takes them with ClearDirtyLines().
+ */
+
+const uint32 *MOS6569::DirtyLines(void)
+{
+	return dirty_lines;
+}
+
+void MOS6569::ClearDirtyLines(void)
+{
+	memset(dirty_lines, 0, sizeof(dirty_lines));
+}
+
+#ifdef GLOBAL_VARS
+static inline bool line_changed(const uint8 *p, int y)
+#else
+inline bool MOS6569::line_changed(const uint8 *p, int y)
+#endif
+{
+	uint8 *q = last_frame + y * DISPLAY_X;
+
+	if (memcmp(p, q, DISPLAY_X)) {
+		memcpy(q, p, DISPLAY_X);
+		return true;
+	}
+	return false;
+}
+
+#ifdef GLOBAL_VARS
+static inline void check_line(const uint8 *p, int y)
+#else
+inline void MOS6569::check_line(const uint8 *p, int y)
+#endif
+{
+	if (line_changed(p, y))
+		dirty_lines[y >> 5] |= 1u << (y & 31);
+}
+
+
 /*
  *  Get VIC state
  */
@@ -880,14 +1005,26 @@ static inline void vblank(void)
 inline void MOS6569::vblank(void)
 #endif
 {
+	// The frame must be drawn completely before it is handed over
+	render_wait();
+
 	raster_y = vc_base = 0;
 	lp_triggered = false;
 
 	if (!(frame_skipped = --skip_counter))
-		skip_counter = ThePrefs.SkipFrames;
+		skip_counter = the_c64->SkipFrames();
 
 	the_c64->VBlank(!frame_skipped);
 
+	// Start or end render threads if the preferences have changed
+	int threads = ThePrefs.RenderThreads;
+	if (threads < 0)
+		threads = 0;
+	if (threads > MAX_RENDER_THREADS)
+		threads = MAX_RENDER_THREADS;
+	if (threads != render_threads)
+		render_setup(threads);
+
 	// Get bitmap pointer for next frame. This must be done
 	// after calling the_c64->VBlank() because the preferences
 	// and screen configuration may have been changed there
@@ -896,29 +1033,124 @@ inline void MOS6569::vblank(void)
 }
 
 
+/*
+ *  Fetch the graphics data of a line into l, and write its foreground
+ *  mask to r[]. The mask is made here and not by the expansion kernels,
+ *  because the sprite collisions need it at once while the line may be
+ *  drawn later by a render thread.
+ */
+
+#ifdef GLOBAL_VARS
+static inline void el_fetch(VICLine *l, uint8 *r)
+#else
+inline void MOS6569::el_fetch(VICLine *l, uint8 *r)
+#endif
+{
+	uint8 *gp = l->gfx;
+	uint8 *mp = matrix_line;
+	uint8 *cp = color_line;
+	uint8 *q;
+	uint8 data;
+
+	if (display_state) {
+		if (render_threads) {
+			memcpy(l->matrix_buf, matrix_line, 40);
+			memcpy(l->color_buf, color_line, 40);
+			l->matrix = l->matrix_buf;
+			l->color = l->color_buf;
+		} else {
+			l->matrix = matrix_line;
+			l->color = color_line;
+		}
+
+		switch (display_idx) {
+
+			case 0:	// Standard text
+				q = char_base + rc;
+				for (int i=0; i<40; i++)
+					r[i] = gp[i] = q[mp[i] << 3];
+				break;
+
+			case 1:	// Multicolor text
+				q = char_base + rc;
+				for (int i=0; i<40; i++) {
+					data = gp[i] = q[mp[i] << 3];
+					r[i] = cp[i] & 8 ? vic_multi_mask(data) : data;
+				}
+				break;
+
+			case 2:	// Standard bitmap
+				q = bitmap_base + (vc << 3) + rc;
+				for (int i=0; i<40; i++, q+=8)
+					r[i] = gp[i] = *q;
+				break;
+
+			case 3:	// Multicolor bitmap
+				q = bitmap_base + (vc << 3) + rc;
+				for (int i=0; i<40; i++, q+=8)
+					r[i] = vic_multi_mask(gp[i] = *q);
+				break;
+
+			case 4:	// ECM text
+				q = char_base + rc;
+				for (int i=0; i<40; i++) {
+					r[i] = mp[i];
+					gp[i] = q[(mp[i] & 0x3f) << 3];
+				}
+				break;
+
+			default:	// Invalid mode (all black)
+				memset(r, 0, 40);
+				break;
+		}
+		vc += 40;
+
+	} else {	// Idle state graphics
+		switch (display_idx) {
+
+			case 0:		// Standard text
+			case 1:		// Multicolor text
+			case 4:		// ECM text
+				data = *get_physical(ctrl1 & 0x40 ? 0x39ff : 0x3fff);
+				break;
+
+			case 3:		// Multicolor bitmap
+				data = *get_physical(0x3fff);
+				break;
+
+			default:	// Invalid mode (all black)
+				memset(r, 0, 40);
+				return;
+		}
+		memset(gp, data, 40);
+		memset(r, data, 40);
+	}
+}
+
+
 #ifdef __riscos__
 #include "el_Acorn.h"
 #else
 
 #ifdef GLOBAL_VARS
-static inline void el_std_text(uint8 *p, uint8 *q, uint8 *r)
+static inline void el_std_text(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_std_text(uint8 *p, uint8 *q, uint8 *r)
+inline void MOS6569::el_std_text(uint8 *p, const VICLine *l)
 #endif
 {
-	unsigned int b0cc = b0c;
+	unsigned int b0cc = l->bc[0];
 #ifdef __POWERPC__
 	double *dp = (double *)p - 1;
 #else
 	uint32 *lp = (uint32 *)p;
 #endif
-	uint8 *cp = color_line;
-	uint8 *mp = matrix_line;
+	const uint8 *cp = l->color;
+	const uint8 *gp = l->gfx;
 
 	// Loop for 40 characters
 	for (int i=0; i<40; i++) {
 		uint8 color = cp[i];
-		uint8 data = r[i] = q[mp[i] << 3];
+		uint8 data = gp[i];
 
 #ifdef 	__POWERPC__
 		*++dp = TextColorTable[color][b0cc][data].b;
@@ -931,23 +1163,35 @@ inline void MOS6569::el_std_text(uint8 *p, uint8 *q, uint8 *r)
 
 
 #ifdef GLOBAL_VARS
-static inline void el_mc_text(uint8 *p, uint8 *q, uint8 *r)
+static inline void el_mc_text(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_mc_text(uint8 *p, uint8 *q, uint8 *r)
+inline void MOS6569::el_mc_text(uint8 *p, const VICLine *l)
 #endif
 {
+	const uint8 *cp = l->color;
+	const uint8 *gp = l->gfx;
+#if VIC_SIMD
+	// Loop for 40 characters
+	for (int i=0; i<40; i++, p+=8) {
+		uint8 data = gp[i];
+
+		if (cp[i] & 8)
+			vic_expand_multi(p, data, l->b0c_color, l->b1c_color, l->b2c_color, colors[cp[i] & 7]);
+		else // Standard mode in multicolor mode
+			vic_expand_std(p, data, l->b0c_color, colors[cp[i]]);
+	}
+#else
 	uint16 *wp = (uint16 *)p;
-	uint8 *cp = color_line;
-	uint8 *mp = matrix_line;
-	uint16 *mclp = mc_color_lookup;
+	uint16 mclp[4];
+
+	memcpy(mclp, l->mc_color_lookup, sizeof(mclp));
 
 	// Loop for 40 characters
 	for (int i=0; i<40; i++) {
-		uint8 data = q[mp[i] << 3];
+		uint8 data = gp[i];
 
 		if (cp[i] & 8) {
 			uint8 color = colors[cp[i] & 7];
-			r[i] = (data & 0xaa) | (data & 0xaa) >> 1;
 			mclp[3] = color | (color << 8);
 			*wp++ = mclp[(data >> 6) & 3];
 			*wp++ = mclp[(data >> 4) & 3];
@@ -956,25 +1200,25 @@ inline void MOS6569::el_mc_text(uint8 *p, uint8 *q, uint8 *r)
 
 		} else { // Standard mode in multicolor mode
 			uint8 color = cp[i];
-			r[i] = data;
 #ifdef __POWERPC__
-			*(double *)wp = TextColorTable[color][b0c][data].b;
+			*(double *)wp = TextColorTable[color][l->bc[0]][data].b;
 			wp += 4;
 #else
-			*(uint32 *)wp = TextColorTable[color][b0c][data][0].b;
+			*(uint32 *)wp = TextColorTable[color][l->bc[0]][data][0].b;
 			wp += 2;
-			*(uint32 *)wp = TextColorTable[color][b0c][data][1].b;
+			*(uint32 *)wp = TextColorTable[color][l->bc[0]][data][1].b;
 			wp += 2;
 #endif
 		}
 	}
+#endif
 }
 
 
 #ifdef GLOBAL_VARS
-static inline void el_std_bitmap(uint8 *p, uint8 *q, uint8 *r)
+static inline void el_std_bitmap(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_std_bitmap(uint8 *p, uint8 *q, uint8 *r)
+inline void MOS6569::el_std_bitmap(uint8 *p, const VICLine *l)
 #endif
 {
 #ifdef __POWERPC__
@@ -982,11 +1226,12 @@ inline void MOS6569::el_std_bitmap(uint8 *p, uint8 *q, uint8 *r)
 #else
 	uint32 *lp = (uint32 *)p;
 #endif
-	uint8 *mp = matrix_line;
+	const uint8 *mp = l->matrix;
+	const uint8 *gp = l->gfx;
 
 	// Loop for 40 characters
-	for (int i=0; i<40; i++, q+=8) {
-		uint8 data = r[i] = *q;
+	for (int i=0; i<40; i++) {
+		uint8 data = gp[i];
 		uint8 color = mp[i] >> 4;
 		uint8 bcolor = mp[i] & 15;
 
@@ -1001,15 +1246,27 @@ inline void MOS6569::el_std_bitmap(uint8 *p, uint8 *q, uint8 *r)
 
 
 #ifdef GLOBAL_VARS
-static inline void el_mc_bitmap(uint8 *p, uint8 *q, uint8 *r)
+static inline void el_mc_bitmap(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_mc_bitmap(uint8 *p, uint8 *q, uint8 *r)
+inline void MOS6569::el_mc_bitmap(uint8 *p, const VICLine *l)
 #endif
 {
+	const uint8 *cp = l->color;
+	const uint8 *mp = l->matrix;
+	const uint8 *gp = l->gfx;
+#if VIC_SIMD
+	uint8 c1[40], c2[40], c3[40];
+
+	// Look up the colors of 40 characters, then expand them at once
+	for (int i=0; i<40; i++) {
+		c1[i] = colors[mp[i] >> 4];
+		c2[i] = colors[mp[i]];
+		c3[i] = colors[cp[i]];
+	}
+	vic_expand_multi_line(p, gp, l->b0c_color, c1, c2, c3);
+#else
 	uint16 lookup[4];
 	uint16 *wp = (uint16 *)p - 1;
-	uint8 *cp = color_line;
-	uint8 *mp = matrix_line;
 
 #ifdef __GNU_C__
 	&lookup; /* Statement with no effect other than preventing GCC from
@@ -1017,10 +1274,10 @@ inline void MOS6569::el_mc_bitmap(uint8 *p, uint8 *q, uint8 *r)
 			  * spectacularly bad code. */
 #endif
 
-	lookup[0] = (b0c_color << 8) | b0c_color;
+	lookup[0] = (l->b0c_color << 8) | l->b0c_color;
 
 	// Loop for 40 characters
-	for (int i=0; i<40; i++, q+=8) {
+	for (int i=0; i<40; i++) {
 		uint8 color, acolor, bcolor;
 
 		color = colors[mp[i] >> 4];
@@ -1030,21 +1287,21 @@ inline void MOS6569::el_mc_bitmap(uint8 *p, uint8 *q, uint8 *r)
 		acolor = colors[cp[i]];
 		lookup[3] = (acolor << 8) | acolor;
 
-		uint8 data = *q;
-		r[i] = (data & 0xaa) | (data & 0xaa) >> 1;
+		uint8 data = gp[i];
 
 		*++wp = lookup[(data >> 6) & 3];
 		*++wp = lookup[(data >> 4) & 3];
 		*++wp = lookup[(data >> 2) & 3];
 		*++wp = lookup[(data >> 0) & 3];
 	}
+#endif
 }
 
 
 #ifdef GLOBAL_VARS
-static inline void el_ecm_text(uint8 *p, uint8 *q, uint8 *r)
+static inline void el_ecm_text(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_ecm_text(uint8 *p, uint8 *q, uint8 *r)
+inline void MOS6569::el_ecm_text(uint8 *p, const VICLine *l)
 #endif
 {
 #ifdef __POWERPC__
@@ -1052,17 +1309,17 @@ inline void MOS6569::el_ecm_text(uint8 *p, uint8 *q, uint8 *r)
 #else
 	uint32 *lp = (uint32 *)p;
 #endif
-	uint8 *cp = color_line;
-	uint8 *mp = matrix_line;
-	uint8 *bcp = &b0c;
+	const uint8 *cp = l->color;
+	const uint8 *mp = l->matrix;
+	const uint8 *gp = l->gfx;
+	const uint8 *bcp = l->bc;
 
 	// Loop for 40 characters
 	for (int i=0; i<40; i++) {
-		uint8 data = r[i] = mp[i];
+		uint8 data = gp[i];
 		uint8 color = cp[i];
-		uint8 bcolor = bcp[(data >> 6) & 3];
+		uint8 bcolor = bcp[(mp[i] >> 6) & 3];
 
-		data = q[(data & 0x3f) << 3];
 #ifdef __POWERPC__
 		*++dp = TextColorTable[color][bcolor][data].b;
 #else
@@ -1074,48 +1331,42 @@ inline void MOS6569::el_ecm_text(uint8 *p, uint8 *q, uint8 *r)
 
 
 #ifdef GLOBAL_VARS
-static inline void el_std_idle(uint8 *p, uint8 *r)
+static inline void el_std_idle(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_std_idle(uint8 *p, uint8 *r)
+inline void MOS6569::el_std_idle(uint8 *p, const VICLine *l)
 #endif
 {
+	uint8 data = l->gfx[0];
 #ifdef __POWERPC__
-	uint8 data = *get_physical(ctrl1 & 0x40 ? 0x39ff : 0x3fff);
 	double *dp = (double *)p - 1;
-	double conv = TextColorTable[0][b0c][data].b;
-	r--;
+	double conv = TextColorTable[0][l->bc[0]][data].b;
 
-	for (int i=0; i<40; i++) {
+	for (int i=0; i<40; i++)
 		*++dp = conv;
-		*++r = data;
-	}
 #else
-	uint8 data = *get_physical(ctrl1 & 0x40 ? 0x39ff : 0x3fff);
 	uint32 *lp = (uint32 *)p;
-	uint32 conv0 = TextColorTable[0][b0c][data][0].b;
-	uint32 conv1 = TextColorTable[0][b0c][data][1].b;
+	uint32 conv0 = TextColorTable[0][l->bc[0]][data][0].b;
+	uint32 conv1 = TextColorTable[0][l->bc[0]][data][1].b;
 
 	for (int i=0; i<40; i++) {
 		*lp++ = conv0;
 		*lp++ = conv1;
-		*r++ = data;
 	}
 #endif
 }
 
 
 #ifdef GLOBAL_VARS
-static inline void el_mc_idle(uint8 *p, uint8 *r)
+static inline void el_mc_idle(uint8 *p, const VICLine *l)
 #else
-inline void MOS6569::el_mc_idle(uint8 *p, uint8 *r)
+inline void MOS6569::el_mc_idle(uint8 *p, const VICLine *l)
 #endif
 {
-	uint8 data = *get_physical(0x3fff);
+	uint8 data = l->gfx[0];
 	uint32 *lp = (uint32 *)p - 1;
-	r--;
 
 	uint16 lookup[4];
-	lookup[0] = (b0c_color << 8) | b0c_color;
+	lookup[0] = (l->b0c_color << 8) | l->b0c_color;
 	lookup[1] = lookup[2] = lookup[3] = colors[0];
 
 	uint16 conv0 = (lookup[(data >> 6) & 3] << 16) | lookup[(data >> 4) & 3];
@@ -1124,37 +1375,41 @@ inline void MOS6569::el_mc_idle(uint8 *p, uint8 *r)
 	for (int i=0; i<40; i++) {
 		*++lp = conv0;
 		*++lp = conv1;
-		*++r = data;
 	}
 }
 
 #endif //__riscos__
 
 
+/*
+ *  Get the sprites of a line into l, detect their collisions and
+ *  hide their pixels behind the graphics and other sprites
+ */
+
 #ifdef GLOBAL_VARS
-static inline void el_sprites(uint8 *chunky_ptr)
+static inline void el_sprites(VICLine *l)
 #else
-inline void MOS6569::el_sprites(uint8 *chunky_ptr)
+inline void MOS6569::el_sprites(VICLine *l)
 #endif
 {
-	int i;
 	int snum, sbit;		// Sprite number/bit mask
 	int spr_coll=0, gfx_coll=0;
+	int spr_lines=0;	// Sprites that have pixels in this line
+	int *spr_x = l->spr_x;	// Their position in the line
+	uint64 *spr_plane0 = l->spr_plane0, *spr_plane1 = l->spr_plane1;	// and bit planes
+	uint64 covered[8];	// Their pixels hidden by other sprites
 
-	// Draw each active sprite
-	for (snum=0, sbit=1; snum<8; snum++, sbit<<=1)
+	// Loop for all sprites
+	for (snum=0, sbit=1; snum<8; snum++, sbit<<=1) {
+
+		// Is sprite visible?
 		if ((sprite_on & sbit) && mx[snum] < DISPLAY_X-32) {
 			int spr_mask_pos;	// Sprite bit position in fore_mask_buf
 			uint32 sdata, fore_mask;
 
-			uint8 *p = chunky_ptr + mx[snum] + 8;
-			uint8 *q = spr_coll_buf + mx[snum] + 8;
-
 			uint8 *sdatap = get_physical(matrix_base[0x3f8 + snum] << 6 | mc[snum]);
 			sdata = (*sdatap << 24) | (*(sdatap+1) << 16) | (*(sdatap+2) << 8);
 
-			uint8 color = spr_color[snum];
-
 			spr_mask_pos = mx[snum] + 8 - x_scroll;
 			
 			uint8 *fmbp = fore_mask_buf + (spr_mask_pos / 8);
@@ -1194,47 +1449,8 @@ inline void MOS6569::el_sprites(uint8 *chunky_ptr)
 						}
 					}
 
-					// Paint sprite
-					for (i=0; i<32; i++, plane0_l<<=1, plane1_l<<=1) {
-						uint8 col;
-						if (plane1_l & 0x80000000) {
-							if (plane0_l & 0x80000000)
-								col = mm1_color;
-							else
-								col = color;
-						} else {
-							if (plane0_l & 0x80000000)
-								col = mm0_color;
-							else
-								continue;
-						}
-						if (q[i])
-							spr_coll |= q[i] | sbit;
-						else {
-							p[i] = col;
-							q[i] = sbit;
-						}
-					}
-					for (; i<48; i++, plane0_r<<=1, plane1_r<<=1) {
-						uint8 col;
-						if (plane1_r & 0x80000000) {
-							if (plane0_r & 0x80000000)
-								col = mm1_color;
-							else
-								col = color;
-						} else {
-							if (plane0_r & 0x80000000)
-								col = mm0_color;
-							else
-								continue;
-						}
-						if (q[i])
-							spr_coll |= q[i] | sbit;
-						else {
-							p[i] = col;
-							q[i] = sbit;
-						}
-					}
+					spr_plane0[snum] = (uint64)plane0_l << 32 | plane0_r;
+					spr_plane1[snum] = (uint64)plane1_l << 32 | plane1_r;
 
 				} else {			// Standard mode
 
@@ -1251,28 +1467,11 @@ inline void MOS6569::el_sprites(uint8 *chunky_ptr)
 						}
 					}
 
-					// Paint sprite
-					for (i=0; i<32; i++, sdata_l<<=1)
-						if (sdata_l & 0x80000000) {
-							if (q[i])	// Collision with sprite?
-								spr_coll |= q[i] | sbit;
-							else {		// Draw pixel if no collision
-								p[i] = color;
-								q[i] = sbit;
-							}
-						}
-					for (; i<48; i++, sdata_r<<=1)
-						if (sdata_r & 0x80000000) {
-							if (q[i]) 	// Collision with sprite?
-								spr_coll |= q[i] | sbit;
-							else {		// Draw pixel if no collision
-								p[i] = color;
-								q[i] = sbit;
-							}
-						}
+					spr_plane0[snum] = 0;
+					spr_plane1[snum] = (uint64)sdata_l << 32 | sdata_r;
 				}
 
-			} else					// Unexpanded
+			} else {				// Unexpanded
 
 				if (mmc & sbit) {	// Multicolor mode
 					uint32 plane0, plane1;
@@ -1290,27 +1489,8 @@ inline void MOS6569::el_sprites(uint8 *chunky_ptr)
 						}
 					}
 
-					// Paint sprite
-					for (i=0; i<24; i++, plane0<<=1, plane1<<=1) {
-						uint8 col;
-						if (plane1 & 0x80000000) {
-							if (plane0 & 0x80000000)
-								col = mm1_color;
-							else
-								col = color;
-						} else {
-							if (plane0 & 0x80000000)
-								col = mm0_color;
-							else
-								continue;
-						}
-						if (q[i])
-							spr_coll |= q[i] | sbit;
-						else {
-							p[i] = col;
-							q[i] = sbit;
-						}
-					}
+					spr_plane0[snum] = (uint64)plane0 << 32;
+					spr_plane1[snum] = (uint64)plane1 << 32;
 
 				} else {			// Standard mode
 
@@ -1320,20 +1500,49 @@ inline void MOS6569::el_sprites(uint8 *chunky_ptr)
 						if (mdp & sbit)
 							sdata &= ~fore_mask;	// Mask sprite if in background
 					}
-	
-					// Paint sprite
-					for (i=0; i<24; i++, sdata<<=1)
-						if (sdata & 0x80000000) {
-							if (q[i]) {		// Collision with sprite?
-								spr_coll |= q[i] | sbit;
-							} else {		// Draw pixel if no collision
-								p[i] = color;
-								q[i] = sbit;
-							}
-						}
 
+					spr_plane0[snum] = 0;
+					spr_plane1[snum] = (uint64)sdata << 32;
 				}
+			}
+
+			spr_x[snum] = mx[snum] + 8;
+			spr_lines |= sbit;
 		}
+	}
+
+	// Sprite-sprite collisions and priorities: The pixels of each sprite
+	// are compared with those of the sprites with lower numbers that are
+	// less than 48 pixels away, and hidden where they overlap
+	for (snum=0, sbit=1; snum<8; snum++, sbit<<=1) {
+		if (!(spr_lines & sbit))
+			continue;
+
+		uint64 pixels = spr_plane0[snum] | spr_plane1[snum];
+		covered[snum] = 0;
+		for (int i=0, ibit=1; i<snum; i++, ibit<<=1) {
+			int dx = spr_x[snum] - spr_x[i];
+			if (!(spr_lines & ibit) || dx >= 48 || dx <= -48)
+				continue;
+			uint64 other = spr_plane0[i] | spr_plane1[i];
+			other = dx >= 0 ? other << dx : other >> -dx;
+			if (other & pixels) {
+				spr_coll |= ibit | sbit;
+				covered[snum] |= other;
+			}
+		}
+	}
+
+	// Keep what is painted
+	for (snum=0, sbit=1; snum<8; snum++, sbit<<=1)
+		if (spr_lines & sbit) {
+			spr_plane0[snum] &= ~covered[snum];
+			spr_plane1[snum] &= ~covered[snum];
+			l->spr_color[snum] = spr_color[snum];
+		}
+	l->spr_lines = spr_lines;
+	l->mm0_color = mm0_color;
+	l->mm1_color = mm1_color;
 
 	if (ThePrefs.SpriteCollisions) {
 
@@ -1539,6 +1748,223 @@ static asm void fastcopy(register uchar *dst, register uchar *src)
 #endif
 
 
+/*
+ *  Draw a recorded line, buf is an aligned buffer for one line of graphics
+ */
+
+#ifdef GLOBAL_VARS
+static void el_draw_line(const VICLine *l, uint8 *buf)
+#else
+void MOS6569::el_draw_line(const VICLine *l, uint8 *buf)
+#endif
+{
+	// Our output goes here
+#ifdef __POWERPC__
+	double chunky_tmp[DISPLAY_X/8];
+	uint8 *chunky_ptr = (uint8 *)chunky_tmp;
+#else
+	uint8 *chunky_ptr = l->p;
+#endif
+
+	if (l->mode != LINE_BORDER) {
+
+		// Display window contents, background on the left if XScroll>0
+		uint8 *p = chunky_ptr + COL40_XSTART;
+		memset(p, l->b0c_color, l->x_scroll);
+		p += l->x_scroll;
+
+		// Graphics that can't be written to p directly go to buf first
+#if defined(ALIGNMENT_CHECK)
+		uint8 *q = (((long)p) & 3) == 0 ? p : buf;
+#elif !defined(CAN_ACCESS_UNALIGNED)
+		uint8 *q = l->x_scroll ? buf : p;
+#else
+		uint8 *q = p;
+#endif
+
+		switch (l->mode) {
+			case 0:				el_std_text(q, l); break;
+			case 1:				el_mc_text(q, l); break;
+			case 2:				el_std_bitmap(q, l); break;
+			case 3:				el_mc_bitmap(q, l); break;
+			case 4:				el_ecm_text(q, l); break;
+			case LINE_IDLE+0:
+			case LINE_IDLE+1:
+			case LINE_IDLE+4:	el_std_idle(q, l); break;
+			case LINE_IDLE+3:	el_mc_idle(q, l); break;
+			default:			memset(q, colors[0], 320); break;	// Invalid mode (all black)
+		}
+		if (q != p)
+			memcpy(p, q, 8*40);
+
+		// Draw sprites
+		for (int snum=0; snum<8; snum++)
+			if (l->spr_lines & (1 << snum))
+				vic_paint_sprite(chunky_ptr + l->spr_x[snum], l->spr_plane0[snum], l->spr_plane1[snum],
+					l->spr_color[snum], l->mm0_color, l->mm1_color);
+
+		// Handle left/right border
+		memset(chunky_ptr, l->ec_color, COL40_XSTART);
+		memset(chunky_ptr + COL40_XSTOP, l->ec_color, DISPLAY_X-COL40_XSTOP);
+		if (!l->border_40_col) {
+			memset(chunky_ptr + COL40_XSTART, l->ec_color, COL38_XSTART-COL40_XSTART);
+			memset(chunky_ptr + COL38_XSTOP, l->ec_color, COL40_XSTOP-COL38_XSTOP);
+		}
+
+	} else {
+
+		// Display border
+		memset(chunky_ptr, l->ec_color, DISPLAY_X);
+	}
+
+#ifdef __POWERPC__
+	// Copy temporary buffer to bitmap
+	fastcopy(l->p, chunky_ptr);
+#endif
+}
+
+
+/*
+ *  Render threads (RenderThreads preference): The recorded lines are
+ *  queued in batches of RENDER_BATCH as the raster goes down, and
+ *  each thread draws a batch at a time. In VBlank the emulation
+ *  thread draws what is left and waits for the rest. Nothing but the
+ *  recorded lines, the bitmap and the changed lines is touched by the
+ *  threads.
+ */
+
+// Draw the next batch of queued lines, with render_lock held
+#ifdef GLOBAL_VARS
+static void render_batch(uint8 *buf)
+#else
+void MOS6569::render_batch(uint8 *buf)
+#endif
+{
+	int first = lines_taken;
+	int last = first + RENDER_BATCH;
+	if (last > lines_queued)
+		last = lines_queued;
+	lines_taken = last;
+	SDL_mutexV(render_lock);
+
+	uint32 changed = 0;
+	for (int y=first; y<last; y++) {
+		el_draw_line(&lines[y], buf);
+		if (line_changed(lines[y].p, y))
+			changed |= 1u << (y & 31);
+	}
+
+	SDL_mutexP(render_lock);
+	dirty_lines[first >> 5] |= changed;
+	lines_done += last - first;
+	if (lines_done == lines_queued)
+		SDL_CondBroadcast(render_cond);
+}
+
+#ifdef GLOBAL_VARS
+static void render_loop(void)
+#else
+void MOS6569::render_loop(void)
+#endif
+{
+	double buf[40];		// Line graphics buffer of this thread
+
+	SDL_mutexP(render_lock);
+	while (!render_quit) {
+		if (lines_taken != lines_queued)
+			render_batch((uint8 *)buf);
+		else
+			SDL_CondWait(render_cond, render_lock);
+	}
+	SDL_mutexV(render_lock);
+}
+
+#ifdef GLOBAL_VARS
+static int render_func(void *vic)
+{
+	render_loop();
+	return 0;
+}
+#else
+int MOS6569::render_func(void *vic)
+{
+	((MOS6569 *)vic)->render_loop();
+	return 0;
+}
+#endif
+
+#ifdef GLOBAL_VARS
+static void render_setup(int threads)
+#else
+void MOS6569::render_setup(int threads)
+#endif
+{
+	// End the running threads
+	if (render_threads) {
+		SDL_mutexP(render_lock);
+		render_quit = true;
+		SDL_CondBroadcast(render_cond);
+		SDL_mutexV(render_lock);
+		for (int i=0; i<render_threads; i++)
+			SDL_WaitThread(render_thread[i], NULL);
+		render_threads = 0;
+	}
+
+	if (threads == 0)
+		return;
+	if (render_lock == NULL)
+		render_lock = SDL_CreateMutex();
+	if (render_cond == NULL)
+		render_cond = SDL_CreateCond();
+	if (render_lock == NULL || render_cond == NULL)
+		return;		// Draw on the emulation thread
+
+	render_quit = false;
+	while (render_threads < threads) {
+#ifdef GLOBAL_VARS
+		render_thread[render_threads] = SDL_CreateThread(render_func, NULL);
+#else
+		render_thread[render_threads] = SDL_CreateThread(render_func, this);
+#endif
+		if (render_thread[render_threads] == NULL)
+			break;
+		render_threads++;
+	}
+}
+
+// Let the threads draw the lines before line n
+#ifdef GLOBAL_VARS
+static inline void render_publish(int n)
+#else
+inline void MOS6569::render_publish(int n)
+#endif
+{
+	SDL_mutexP(render_lock);
+	lines_queued = n;
+	SDL_CondSignal(render_cond);
+	SDL_mutexV(render_lock);
+}
+
+// Help drawing the queued lines and wait until all of them are drawn
+#ifdef GLOBAL_VARS
+static void render_wait(void)
+#else
+void MOS6569::render_wait(void)
+#endif
+{
+	if (render_threads == 0)
+		return;
+
+	SDL_mutexP(render_lock);
+	while (lines_taken != lines_queued)
+		render_batch(text_chunky_buf);
+	while (lines_done != lines_queued)
+		SDL_CondWait(render_cond, render_lock);
+	lines_queued = lines_taken = lines_done = 0;
+	SDL_mutexV(render_lock);
+}
+
+
 /*
  *  Emulate one raster line
  */
@@ -1579,13 +2005,6 @@ int MOS6569::EmulateLine(void)
 	// Within the visible range?
 	if (raster >= FIRST_DISP_LINE && raster <= LAST_DISP_LINE) {
 
-		// Our output goes here
-#ifdef __POWERPC__
-		uint8 *chunky_ptr = (uint8 *)chunky_tmp;
-#else
-		uint8 *chunky_ptr = chunky_line_start;
-#endif
-
 		// Set video counter
 		vc = vc_base;
 
@@ -1615,243 +2034,45 @@ int MOS6569::EmulateLine(void)
 		if (raster == dy_start && (ctrl1 & 0x10)) // Don't turn off border if DEN bit cleared
 			border_on = false;
 
-		if (!border_on) {
-
-			// Display window contents
-			uint8 *p = chunky_ptr + COL40_XSTART;		// Pointer in chunky display buffer
-			uint8 *r = fore_mask_buf + COL40_XSTART/8;	// Pointer in foreground mask buffer
-#ifdef ALIGNMENT_CHECK
-			uint8 *use_p = ((((int)p) & 3) == 0) ? p : text_chunky_buf;
-#endif
-
-			{
-				p--;
-				uint8 b0cc = b0c_color;
-				int limit = x_scroll;
-				for (int i=0; i<limit; i++)	// Background on the left if XScroll>0
-					*++p = b0cc;
-				p++;
-			}
+		// Record the line, the render threads need all lines of the frame
+		int y = raster - FIRST_DISP_LINE;
+		VICLine line, *l = render_threads ? &lines[y] : &line;
+		l->p = chunky_line_start;
+		l->ec_color = ec_color;
 
-			if (display_state) {
-				switch (display_idx) {
-
-					case 0:	// Standard text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_std_text(use_p, char_base + rc, r);
-						if (use_p != p)
-							memcpy(p, use_p, 8*40);
-#else
-						if (x_scroll) {
-							el_std_text(text_chunky_buf, char_base + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_std_text(p, char_base + rc, r);
-#endif
-#else
-						el_std_text(p, char_base + rc, r);
-#endif
-						break;
-
-					case 1:	// Multicolor text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_mc_text(use_p, char_base + rc, r);
-						if (use_p != p)
-							memcpy(p, use_p, 8*40);
-#else
-						if (x_scroll) {
-							el_mc_text(text_chunky_buf, char_base + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_mc_text(p, char_base + rc, r);
-#endif
-#else
-						el_mc_text(p, char_base + rc, r);
-#endif
-						break;
-
-					case 2:	// Standard bitmap
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_std_bitmap(use_p, bitmap_base + (vc << 3) + rc, r);
-						if (use_p != p)
-							memcpy(p, use_p, 8*40);
-#else
-						if (x_scroll) {
-							el_std_bitmap(text_chunky_buf, bitmap_base + (vc << 3) + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_std_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-#else
-						el_std_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-						break;
-
-					case 3:	// Multicolor bitmap
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_mc_bitmap(use_p, bitmap_base + (vc << 3) + rc, r);
-						if (use_p != p)
-							memcpy(p, use_p, 8*40);
-#else
-						if (x_scroll) {
-							el_mc_bitmap(text_chunky_buf, bitmap_base + (vc << 3) + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_mc_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-#else
-						el_mc_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-						break;
-
-					case 4:	// ECM text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_ecm_text(use_p, char_base + rc, r);
-						if (use_p != p)
-							memcpy(p, use_p, 8*40);
-#else
-						if (x_scroll) {
-							el_ecm_text(text_chunky_buf, char_base + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_ecm_text(p, char_base + rc, r);
-#endif
-#else
-						el_ecm_text(p, char_base + rc, r);
-#endif
-						break;
-
-					default:	// Invalid mode (all black)
-						memset(p, colors[0], 320);
-						memset(r, 0, 40);
-						break;
-				}
-				vc += 40;
-
-			} else {	// Idle state graphics
-				switch (display_idx) {
-
-					case 0:		// Standard text
-					case 1:		// Multicolor text
-					case 4:		// ECM text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_std_idle(use_p, r);
-						if (use_p != p) {memcpy(p, use_p, 8*40);}
-#else
-						if (x_scroll) {
-							el_std_idle(text_chunky_buf, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_std_idle(p, r);
-#endif
-#else
-						el_std_idle(p, r);
-#endif
-						break;
-
-					case 3:		// Multicolor bitmap
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_mc_idle(use_p, r);
-						if (use_p != p) {memcpy(p, use_p, 8*40);}
-#else
-						if (x_scroll) {
-							el_mc_idle(text_chunky_buf, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_mc_idle(p, r);
-#endif
-#else
-						el_mc_idle(p, r);
-#endif
-						break;
-
-					default:	// Invalid mode (all black)
-						memset(p, colors[0], 320);
-						memset(r, 0, 40);
-						break;
-				}
-			}
-
-			// Draw sprites
-			if (sprite_on && ThePrefs.SpritesOn) {
-
-				// Clear sprite collision buffer
-				uint32 *lp = (uint32 *)spr_coll_buf - 1;
-				for (int i=0; i<DISPLAY_X/4; i++)
-					*++lp = 0;
-
-				el_sprites(chunky_ptr);
-			}
-
-			// Handle left/right border
-			uint32 *lp = (uint32 *)chunky_ptr - 1;
-			uint32 c = ec_color_long;
-			for (int i=0; i<COL40_XSTART/4; i++)
-				*++lp = c;
-			lp = (uint32 *)(chunky_ptr + COL40_XSTOP) - 1;
-			for (int i=0; i<(DISPLAY_X-COL40_XSTOP)/4; i++)
-				*++lp = c;
-			if (!border_40_col) {
-				c = ec_color;
-				p = chunky_ptr + COL40_XSTART - 1;
-				for (int i=0; i<COL38_XSTART-COL40_XSTART; i++)
-					*++p = c;
-				p = chunky_ptr + COL38_XSTOP - 1;
-				for (int i=0; i<COL40_XSTOP-COL38_XSTOP; i++)
-					*++p = c;
-			}
+		if (!border_on) {
+			l->mode = display_state ? display_idx : LINE_IDLE + display_idx;
+			l->x_scroll = x_scroll;
+			l->border_40_col = border_40_col;
+			l->b0c_color = b0c_color;
+			l->b1c_color = b1c_color;
+			l->b2c_color = b2c_color;
+			l->bc[0] = b0c;
+			l->bc[1] = b1c;
+			l->bc[2] = b2c;
+			l->bc[3] = b3c;
+			memcpy(l->mc_color_lookup, mc_color_lookup, sizeof(mc_color_lookup));
+
+			// Graphics data and foreground mask
+			el_fetch(l, fore_mask_buf + COL40_XSTART/8);
+
+			// Sprites, their collisions are detected now
+			if (sprite_on && ThePrefs.SpritesOn)
+				el_sprites(l);
+			else
+				l->spr_lines = 0;
+		} else
+			l->mode = LINE_BORDER;
 
-#if 0
-			if (is_bad_line) {
-				chunky_ptr[DISPLAY_X-2] = colors[7];
-				chunky_ptr[DISPLAY_X-3] = colors[7];
-			}
-			if (rc & 1) {
-				chunky_ptr[DISPLAY_X-4] = colors[1];
-				chunky_ptr[DISPLAY_X-5] = colors[1];
-			}
-			if (rc & 2) {
-				chunky_ptr[DISPLAY_X-6] = colors[1];
-				chunky_ptr[DISPLAY_X-7] = colors[1];
-			}
-			if (rc & 4) {
-				chunky_ptr[DISPLAY_X-8] = colors[1];
-				chunky_ptr[DISPLAY_X-9] = colors[1];
-			}
-			if (ctrl1 & 0x40) {
-				chunky_ptr[DISPLAY_X-10] = colors[5];
-				chunky_ptr[DISPLAY_X-11] = colors[5];
-			}
-			if (ctrl1 & 0x20) {
-				chunky_ptr[DISPLAY_X-12] = colors[3];
-				chunky_ptr[DISPLAY_X-13] = colors[3];
-			}
-			if (ctrl2 & 0x10) {
-				chunky_ptr[DISPLAY_X-14] = colors[2];
-				chunky_ptr[DISPLAY_X-15] = colors[2];
-			}
-#endif
+		// Draw it now, or let the render threads draw it
+		if (render_threads) {
+			if ((y & (RENDER_BATCH-1)) == RENDER_BATCH-1 || raster == LAST_DISP_LINE)
+				render_publish(y + 1);
 		} else {
-
-			// Display border
-			uint32 *lp = (uint32 *)chunky_ptr - 1;
-			uint32 c = ec_color_long;
-			for (int i=0; i<DISPLAY_X/4; i++)
-				*++lp = c;
+			el_draw_line(l, text_chunky_buf);
+			check_line(chunky_line_start, y);
 		}
 
-#ifdef __POWERPC__
-		// Copy temporary buffer to bitmap
-		fastcopy(chunky_line_start, (uint8 *)chunky_tmp);
-#endif
-
 		// Increment pointer in chunky buffer
 		chunky_line_start += xmod;
 
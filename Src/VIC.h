@@ -21,6 +21,8 @@
 #ifndef _VIC_H
 #define _VIC_H
 
+#include "Display.h"
+
 
 // Define this if you have a processor that can do unaligned accesses quickly
 #if defined(__i386) || defined(mc68000) || defined(__MC68K__)
@@ -28,6 +30,9 @@
 #endif
 
 
+// Maximum number of threads drawing the lines (Frodo SL)
+const int MAX_RENDER_THREADS = 8;
+
 // Total number of raster lines (PAL)
 const unsigned TOTAL_RASTERS = 0x138;
 
@@ -39,11 +44,21 @@ class MOS6510;
 class C64Display;
 class C64;
 struct MOS6569State;
+struct MOS6569CycleState;
+#ifndef FRODO_SC
+struct VICLine;
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+#endif
 
 
 class MOS6569 {
 public:
 	MOS6569(C64 *c64, C64Display *disp, MOS6510 *CPU, uint8 *RAM, uint8 *Char, uint8 *Color);
+#ifndef FRODO_SC
+	~MOS6569();
+#endif
 
 	uint8 ReadRegister(uint16 adr);
 	void WriteRegister(uint16 adr, uint8 byte);
@@ -57,8 +72,14 @@ public:
 	void ReInitColors(void);
 	void GetState(MOS6569State *vd);
 	void SetState(MOS6569State *vd);
+	const uint32 *DirtyLines(void);	// Lines of the bitmap that changed since ClearDirtyLines()
+	void ClearDirtyLines(void);
 
 #ifdef FRODO_SC
+	void GetCycleState(MOS6569CycleState *vd);
+	void SetCycleState(MOS6569CycleState *vd);
+	void SetHidden(bool hidden);	// Frames from the current one on are not shown (in raster line 0)
+
 	uint8 LastVICByte;
 #endif
 
@@ -119,11 +140,8 @@ private:
 	int skip_counter;			// Counter for frame-skipping
 
 	long pad0;	// Keep buffers long-aligned
-	uint8 spr_coll_buf[0x180];	// Buffer for sprite-sprite collisions and priorities
 	uint8 fore_mask_buf[0x180/8];	// Foreground mask for sprite-graphics collisions and priorities
-#ifndef CAN_ACCESS_UNALIGNED
 	uint8 text_chunky_buf[40*8];	// Line graphics buffer
-#endif
 
 	bool display_state;			// true: Display state, false: Idle state
 	bool border_on;				// Flag: Upper/lower border on (Frodo SC: Main border flipflop)
@@ -131,6 +149,10 @@ private:
 	uint8 bad_lines_enabled;	// Flag: Bad Lines enabled for this frame
 	bool lp_triggered;			// Flag: Lightpen was triggered in this frame
 
+	void check_line(const uint8 *p, int y);
+	uint32 dirty_lines[DIRTY_WORDS];	// Changed lines, one bit per line
+	uint8 last_frame[DISPLAY_X*DISPLAY_Y];	// Last drawn contents of all lines
+
 #ifdef FRODO_SC
 	uint8 read_byte(uint16 adr);
 	void matrix_access(void);
@@ -172,18 +194,30 @@ private:
 	uint8 spr_draw_data[8][4];	// Sprite data for drawing
 
 	uint32 first_ba_cycle;		// Cycle when BA first went low
+
+	bool hidden;				// Flag: Frames are not shown, draw into hidden_line
+	uint8 hidden_line[0x180*2];	// Scratch line for all lines of these frames
 #else
 	uint8 *get_physical(uint16 adr);
 	void make_mc_table(void);
-	void el_std_text(uint8 *p, uint8 *q, uint8 *r);
-	void el_mc_text(uint8 *p, uint8 *q, uint8 *r);
-	void el_std_bitmap(uint8 *p, uint8 *q, uint8 *r);
-	void el_mc_bitmap(uint8 *p, uint8 *q, uint8 *r);
-	void el_ecm_text(uint8 *p, uint8 *q, uint8 *r);
-	void el_std_idle(uint8 *p, uint8 *r);
-	void el_mc_idle(uint8 *p, uint8 *r);
-	void el_sprites(uint8 *chunky_ptr);
+	void el_fetch(VICLine *l, uint8 *r);
+	void el_sprites(VICLine *l);
+	void el_draw_line(const VICLine *l, uint8 *buf);
+	void el_std_text(uint8 *p, const VICLine *l);
+	void el_mc_text(uint8 *p, const VICLine *l);
+	void el_std_bitmap(uint8 *p, const VICLine *l);
+	void el_mc_bitmap(uint8 *p, const VICLine *l);
+	void el_ecm_text(uint8 *p, const VICLine *l);
+	void el_std_idle(uint8 *p, const VICLine *l);
+	void el_mc_idle(uint8 *p, const VICLine *l);
 	int el_update_mc(int raster);
+	bool line_changed(const uint8 *p, int y);
+	void render_setup(int threads);
+	void render_publish(int n);
+	void render_wait(void);
+	void render_batch(uint8 *buf);
+	static int render_func(void *vic);
+	void render_loop(void);
 
 	uint16 mc_color_lookup[4];
 
@@ -193,6 +227,19 @@ private:
 	uint8 *matrix_base;			// Video matrix base
 	uint8 *char_base;			// Character generator base
 	uint8 *bitmap_base;			// Bitmap base
+
+	VICLine *lines;				// Recorded lines of the current frame
+
+	// Render threads. They draw the recorded lines up to lines_queued,
+	// the members below are protected by render_lock.
+	int render_threads;
+	SDL_Thread *render_thread[MAX_RENDER_THREADS];
+	SDL_mutex *render_lock;
+	SDL_cond *render_cond;		// Signalled when lines are queued or drawn
+	bool render_quit;
+	int lines_queued;			// Lines the threads may draw
+	int lines_taken;			// Lines a thread has started
+	int lines_done;				// Lines that are drawn
 #endif
 #endif
 };
@@ -280,4 +327,14 @@ struct MOS6569State {
 	bool ud_border_on;		// Flag: Upper/lower border on
 };
 
+#ifdef FRODO_SC
+// Frodo SC state that is not part of MOS6569State (and of the snapshot files)
+struct MOS6569CycleState {
+	uint32 ba_age;			// Cycles since BA went low
+	uint8 spr_exp_y;		// 8 sprite y expansion flipflops
+	uint8 matrix_line[40];	// Video line buffer, read in Bad Lines
+	uint8 color_line[40];	// Color line buffer, read in Bad Lines
+};
+#endif
+
 #endif
@@ -36,6 +36,7 @@
 #include "sysdeps.h"
 
 #include "VIC.h"
+#include "VIC_expand.h"
 #include "C64.h"
 #include "CPUC64.h"
 #include "Display.h"
@@ -198,10 +199,13 @@ MOS6569::MOS6569(C64 *c64, C64Display *disp, MOS6510 *CPU, uint8 *RAM, uint8 *Ch
 
 	frame_skipped = false;
 	skip_counter = 1;
+	hidden = false;
 
-	memset(spr_coll_buf, 0, 0x180);
 	memset(fore_mask_buf, 0, 0x180/8);
 
+	memset(last_frame, 0, sizeof(last_frame));
+	memset(dirty_lines, 0xff, sizeof(dirty_lines));
+
 	// Preset colors to black
 	disp->InitColors(colors);
 	ec_color = b0c_color = b1c_color = b2c_color = b3c_color = mm0_color = mm1_color = colors[0];
@@ -255,6 +259,56 @@ void MOS6569::ReInitColors(void)
 }
 
 
+/*
+ *  Hidden frames (run-ahead): Frames that are emulated but not shown
+ *  still go through the whole drawing, because sprite collisions are
+ *  detected while drawing. All their lines go to one scratch line
+ *  instead of the bitmap, though, which then only holds the frames that
+ *  are shown. Switching must happen in raster line 0, before the first
+ *  displayed line.
+ */
+
+void MOS6569::SetHidden(bool hide)
+{
+	hidden = hide;
+	if (hidden) {
+		chunky_line_start = hidden_line;
+		xmod = 0;
+	} else {
+		chunky_line_start = the_display->BitmapBase();
+		xmod = the_display->BitmapXMod();
+	}
+}
+
+
+/*
+ *  Changed lines: Every drawn line is compared with the same line of the
+ *  last drawn frame when it is finished. This catches all changes, also
+ *  those from raster effects, and costs much less than drawing the line.
+ *  The bits collect until the display takes them with ClearDirtyLines().
+ */
+
+const uint32 *MOS6569::DirtyLines(void)
+{
+	return dirty_lines;
+}
+
+void MOS6569::ClearDirtyLines(void)
+{
+	memset(dirty_lines, 0, sizeof(dirty_lines));
+}
+
+inline void MOS6569::check_line(const uint8 *p, int y)
+{
+	uint8 *q = last_frame + y * DISPLAY_X;
+
+	if (memcmp(p, q, DISPLAY_X)) {
+		memcpy(q, p, DISPLAY_X);
+		dirty_lines[y >> 5] |= 1u << (y & 31);
+	}
+}
+
+
 /*
  *  Get VIC state
  */
@@ -426,6 +480,27 @@ void MOS6569::SetState(MOS6569State *vd)
 }
 
 
+/*
+ *  Get/restore the state not held by MOS6569State
+ */
+
+void MOS6569::GetCycleState(MOS6569CycleState *vd)
+{
+	vd->ba_age = the_c64->CycleCounter - first_ba_cycle;
+	vd->spr_exp_y = spr_exp_y;
+	memcpy(vd->matrix_line, matrix_line, sizeof(vd->matrix_line));
+	memcpy(vd->color_line, color_line, sizeof(vd->color_line));
+}
+
+void MOS6569::SetCycleState(MOS6569CycleState *vd)
+{
+	first_ba_cycle = the_c64->CycleCounter - vd->ba_age;
+	spr_exp_y = vd->spr_exp_y;
+	memcpy(matrix_line, vd->matrix_line, sizeof(matrix_line));
+	memcpy(color_line, vd->color_line, sizeof(color_line));
+}
+
+
 /*
  *  Trigger raster IRQ
  */
@@ -813,7 +888,7 @@ void MOS6569::draw_background(void)
 void MOS6569::draw_graphics(void)
 {
 	uint8 *p = chunky_ptr + x_scroll;
-	uint8 c[4], data;
+	uint8 c[4];
 
 	if (!draw_this_line)
 		return;
@@ -870,25 +945,20 @@ void MOS6569::draw_graphics(void)
 
 		case 5:		// Invalid multicolor text
 			memset8(p, colors[0]);
-			if (color_data & 8) {
-				fore_mask_ptr[0] |= ((gfx_data & 0xaa) | (gfx_data & 0xaa) >> 1) >> x_scroll;
-				fore_mask_ptr[1] |= ((gfx_data & 0xaa) | (gfx_data & 0xaa) >> 1) << (8-x_scroll);
-			} else {
-				fore_mask_ptr[0] |= gfx_data >> x_scroll;
-				fore_mask_ptr[1] |= gfx_data << (7-x_scroll);
-			}
+			if (color_data & 8)
+				vic_mask_multi(fore_mask_ptr, gfx_data, x_scroll);
+			else
+				vic_mask_std(fore_mask_ptr, gfx_data, x_scroll);
 			return;
 
 		case 6:		// Invalid standard bitmap
 			memset8(p, colors[0]);
-			fore_mask_ptr[0] |= gfx_data >> x_scroll;
-			fore_mask_ptr[1] |= gfx_data << (7-x_scroll);
+			vic_mask_std(fore_mask_ptr, gfx_data, x_scroll);
 			return;
 
 		case 7:		// Invalid multicolor bitmap
 			memset8(p, colors[0]);
-			fore_mask_ptr[0] |= ((gfx_data & 0xaa) | (gfx_data & 0xaa) >> 1) >> x_scroll;
-			fore_mask_ptr[1] |= ((gfx_data & 0xaa) | (gfx_data & 0xaa) >> 1) << (8-x_scroll);
+			vic_mask_multi(fore_mask_ptr, gfx_data, x_scroll);
 			return;
 
 		default:	// Can't happen
@@ -896,31 +966,11 @@ void MOS6569::draw_graphics(void)
 	}
 
 draw_std:
-
-	fore_mask_ptr[0] |= gfx_data >> x_scroll;
-	fore_mask_ptr[1] |= gfx_data << (7-x_scroll);
-
-	data = gfx_data;
-	p[7] = c[data & 1]; data >>= 1;
-	p[6] = c[data & 1]; data >>= 1;
-	p[5] = c[data & 1]; data >>= 1;
-	p[4] = c[data & 1]; data >>= 1;
-	p[3] = c[data & 1]; data >>= 1;
-	p[2] = c[data & 1]; data >>= 1;
-	p[1] = c[data & 1]; data >>= 1;
-	p[0] = c[data];
+	vic_expand_std_mask(p, fore_mask_ptr, x_scroll, gfx_data, c[0], c[1]);
 	return;
 
 draw_multi:
-
-	fore_mask_ptr[0] |= ((gfx_data & 0xaa) | (gfx_data & 0xaa) >> 1) >> x_scroll;
-	fore_mask_ptr[1] |= ((gfx_data & 0xaa) | (gfx_data & 0xaa) >> 1) << (8-x_scroll);
-
-	data = gfx_data;
-	p[7] = p[6] = c[data & 3]; data >>= 2;
-	p[5] = p[4] = c[data & 3]; data >>= 2;
-	p[3] = p[2] = c[data & 3]; data >>= 2;
-	p[1] = p[0] = c[data];
+	vic_expand_multi_mask(p, fore_mask_ptr, x_scroll, gfx_data, c[0], c[1], c[2], c[3]);
 	return;
 }
 
@@ -931,29 +981,17 @@ draw_multi:
 
 inline void MOS6569::draw_sprites(void)
 {
-	int i;
 	int snum, sbit;		// Sprite number/bit mask
 	int spr_coll=0, gfx_coll=0;
-
-	// Clear sprite collision buffer
-	{
-		uint32 *lp = (uint32 *)spr_coll_buf - 1;
-		for (i=0; i<DISPLAY_X/4; i++)
-			*++lp = 0;
-	}
+	int spr_lines=0;	// Sprites that have pixels in this line
+	int spr_x[8];		// Their position in the line
+	uint64 spr_plane0[8], spr_plane1[8];	// and bit planes (first pixel in the MSB)
 
 	// Loop for all sprites
 	for (snum=0, sbit=1; snum<8; snum++, sbit<<=1) {
 
 		// Is sprite visible?
 		if ((spr_draw & sbit) && mx[snum] <= DISPLAY_X-32) {
-#ifdef __POWERPC__
-			uint8 *p = (uint8 *)chunky_tmp + mx[snum] + 8;
-#else
-			uint8 *p = chunky_line_start + mx[snum] + 8;
-#endif
-			uint8 *q = spr_coll_buf + mx[snum] + 8;
-			uint8 color = spr_color[snum];
 
 			// Fetch sprite data and mask
 			uint32 sdata = (spr_draw_data[snum][0] << 24) | (spr_draw_data[snum][1] << 16) | (spr_draw_data[snum][2] << 8);
@@ -997,47 +1035,8 @@ inline void MOS6569::draw_sprites(void)
 						}
 					}
 
-					// Paint sprite
-					for (i=0; i<32; i++, plane0_l<<=1, plane1_l<<=1) {
-						uint8 col;
-						if (plane1_l & 0x80000000) {
-							if (plane0_l & 0x80000000)
-								col = mm1_color;
-							else
-								col = color;
-						} else {
-							if (plane0_l & 0x80000000)
-								col = mm0_color;
-							else
-								continue;
-						}
-						if (q[i])
-							spr_coll |= q[i] | sbit;
-						else {
-							p[i] = col;
-							q[i] = sbit;
-						}
-					}
-					for (; i<48; i++, plane0_r<<=1, plane1_r<<=1) {
-						uint8 col;
-						if (plane1_r & 0x80000000) {
-							if (plane0_r & 0x80000000)
-								col = mm1_color;
-							else
-								col = color;
-						} else {
-							if (plane0_r & 0x80000000)
-								col = mm0_color;
-							else
-								continue;
-						}
-						if (q[i])
-							spr_coll |= q[i] | sbit;
-						else {
-							p[i] = col;
-							q[i] = sbit;
-						}
-					}
+					spr_plane0[snum] = (uint64)plane0_l << 32 | plane0_r;
+					spr_plane1[snum] = (uint64)plane1_l << 32 | plane1_r;
 
 				} else {			// Standard mode
 
@@ -1054,25 +1053,8 @@ inline void MOS6569::draw_sprites(void)
 						}
 					}
 
-					// Paint sprite
-					for (i=0; i<32; i++, sdata_l<<=1)
-						if (sdata_l & 0x80000000) {
-							if (q[i])	// Collision with sprite?
-								spr_coll |= q[i] | sbit;
-							else {		// Draw pixel if no collision
-								p[i] = color;
-								q[i] = sbit;
-							}
-						}
-					for (; i<48; i++, sdata_r<<=1)
-						if (sdata_r & 0x80000000) {
-							if (q[i]) 	// Collision with sprite?
-								spr_coll |= q[i] | sbit;
-							else {		// Draw pixel if no collision
-								p[i] = color;
-								q[i] = sbit;
-							}
-						}
+					spr_plane0[snum] = 0;
+					spr_plane1[snum] = (uint64)sdata_l << 32 | sdata_r;
 				}
 
 			} else {				// Unexpanded
@@ -1093,27 +1075,8 @@ inline void MOS6569::draw_sprites(void)
 						}
 					}
 
-					// Paint sprite
-					for (i=0; i<24; i++, plane0<<=1, plane1<<=1) {
-						uint8 col;
-						if (plane1 & 0x80000000) {
-							if (plane0 & 0x80000000)
-								col = mm1_color;
-							else
-								col = color;
-						} else {
-							if (plane0 & 0x80000000)
-								col = mm0_color;
-							else
-								continue;
-						}
-						if (q[i])
-							spr_coll |= q[i] | sbit;
-						else {
-							p[i] = col;
-							q[i] = sbit;
-						}
-					}
+					spr_plane0[snum] = (uint64)plane0 << 32;
+					spr_plane1[snum] = (uint64)plane1 << 32;
 
 				} else {			// Standard mode
 
@@ -1123,20 +1086,46 @@ inline void MOS6569::draw_sprites(void)
 						if (mdp & sbit)
 							sdata &= ~fore_mask;	// Mask sprite if in background
 					}
-	
-					// Paint sprite
-					for (i=0; i<24; i++, sdata<<=1)
-						if (sdata & 0x80000000) {
-							if (q[i]) {	// Collision with sprite?
-								spr_coll |= q[i] | sbit;
-							} else {		// Draw pixel if no collision
-								p[i] = color;
-								q[i] = sbit;
-							}
-						}
+
+					spr_plane0[snum] = 0;
+					spr_plane1[snum] = (uint64)sdata << 32;
 				}
 			}
+
+			spr_x[snum] = mx[snum] + 8;
+			spr_lines |= sbit;
+		}
+	}
+
+	// Sprite-sprite collisions and priorities: The pixels of each sprite
+	// are compared with those of the sprites with lower numbers that are
+	// less than 48 pixels away, and hidden where they overlap
+	for (snum=0, sbit=1; snum<8; snum++, sbit<<=1) {
+		if (!(spr_lines & sbit))
+			continue;
+
+		uint64 pixels = spr_plane0[snum] | spr_plane1[snum];
+		uint64 covered = 0;
+		for (int i=0, ibit=1; i<snum; i++, ibit<<=1) {
+			int dx = spr_x[snum] - spr_x[i];
+			if (!(spr_lines & ibit) || dx >= 48 || dx <= -48)
+				continue;
+			uint64 other = spr_plane0[i] | spr_plane1[i];
+			other = dx >= 0 ? other << dx : other >> -dx;
+			if (other & pixels) {
+				spr_coll |= ibit | sbit;
+				covered |= other;
+			}
 		}
+
+		// Paint sprite
+#ifdef __POWERPC__
+		uint8 *p = (uint8 *)chunky_tmp + spr_x[snum];
+#else
+		uint8 *p = chunky_line_start + spr_x[snum];
+#endif
+		vic_paint_sprite(p, spr_plane0[snum] & ~covered, spr_plane1[snum] & ~covered,
+			spr_color[snum], mm0_color, mm1_color);
 	}
 
 	if (ThePrefs.SpriteCollisions) {
@@ -1416,16 +1405,19 @@ bool MOS6569::EmulateCycle(void)
 				ref_cnt = 0xff;
 				lp_triggered = vblanking = false;
 
-				if (!(frame_skipped = --skip_counter))
-					skip_counter = ThePrefs.SkipFrames;
+				// Hidden frames are never skipped, they must detect
+				// sprite collisions like the others
+				if (hidden)
+					frame_skipped = false;
+				else if (!(frame_skipped = --skip_counter))
+					skip_counter = the_c64->SkipFrames();
 
 				the_c64->VBlank(!frame_skipped);
 
 				// Get bitmap pointer for next frame. This must be done
 				// after calling the_c64->VBlank() because the preferences
 				// and screen configuration may have been changed there
-				chunky_line_start = the_display->BitmapBase();
-				xmod = the_display->BitmapXMod();
+				SetHidden(hidden);
 
 				// Trigger raster IRQ if IRQ in line 0
 				if (irq_raster == 0)
@@ -1800,6 +1792,10 @@ bool MOS6569::EmulateCycle(void)
 				fastcopy(chunky_line_start, (uint8 *)chunky_tmp);
 #endif
 
+				// Has the line changed since the last frame?
+				if (!hidden)
+					check_line(chunky_line_start, raster_y - FIRST_DISP_LINE);
+
 				// Increment pointer in chunky buffer
 				chunky_line_start += xmod;
 			}
@@ -0,0 +1,223 @@
+/*
+ *  VIC_expand.h - Expansion of VIC graphics bytes to pixels
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#ifndef _VIC_EXPAND_H
+#define _VIC_EXPAND_H
+
+
+// Set this to 1 to expand the pixels with SSE2 or NEON instructions
+#ifndef VIC_SIMD
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VIC_SIMD 1
+#else
+#define VIC_SIMD 0
+#endif
+#endif
+
+#if VIC_SIMD
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+
+/*
+ *  Foreground mask of a multicolor graphics byte: Pixel pairs with
+ *  colors 2 and 3 are foreground, pairs with colors 0 and 1 background
+ */
+
+static inline uint8 vic_multi_mask(uint8 data)
+{
+	return (data & 0xaa) | (data & 0xaa) >> 1;
+}
+
+
+#if VIC_SIMD && defined(__SSE2__)
+
+/*
+ *  SSE2: Every byte of a vector holds one pixel, each half holds the
+ *  8 pixels of a character. A pixel is chosen from the colors with masks that
+ *  are built by testing each byte against the bit(s) of its pixel.
+ */
+
+// Bit of each pixel, and the high and low bits of each multicolor pixel
+#define VIC_STD_BITS _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128)
+#define VIC_MC_HI_BITS _mm_set_epi8(2, 2, 8, 8, 32, 32, -128, -128, 2, 2, 8, 8, 32, 32, -128, -128)
+#define VIC_MC_LO_BITS _mm_set_epi8(1, 1, 4, 4, 16, 16, 64, 64, 1, 1, 4, 4, 16, 16, 64, 64)
+
+// The 8 bytes at p, each repeated 8 times, in v[0..3]
+static inline void vic_spread8(__m128i *v, const uint8 *p)
+{
+	__m128i x = _mm_loadl_epi64((const __m128i *)p);
+	x = _mm_unpacklo_epi8(x, x);
+	__m128i lo = _mm_unpacklo_epi16(x, x), hi = _mm_unpackhi_epi16(x, x);
+	v[0] = _mm_unpacklo_epi32(lo, lo);
+	v[1] = _mm_unpackhi_epi32(lo, lo);
+	v[2] = _mm_unpacklo_epi32(hi, hi);
+	v[3] = _mm_unpackhi_epi32(hi, hi);
+}
+
+static inline __m128i vic_test(__m128i data, __m128i bits)
+{
+	return _mm_cmpeq_epi8(_mm_and_si128(data, bits), bits);
+}
+
+// Bytes of set where mask is set, of clear elsewhere
+static inline __m128i vic_select(__m128i mask, __m128i set, __m128i clear)
+{
+	return _mm_or_si128(_mm_and_si128(mask, set), _mm_andnot_si128(mask, clear));
+}
+
+static inline __m128i vic_std_pixels(__m128i data, __m128i c0, __m128i c1)
+{
+	return vic_select(vic_test(data, VIC_STD_BITS), c1, c0);
+}
+
+static inline __m128i vic_multi_pixels(__m128i data, __m128i c0, __m128i c1, __m128i c2, __m128i c3)
+{
+	__m128i lo = vic_test(data, VIC_MC_LO_BITS);
+	return vic_select(vic_test(data, VIC_MC_HI_BITS), vic_select(lo, c3, c2), vic_select(lo, c1, c0));
+}
+
+#endif
+
+
+/*
+ *  Expand one graphics byte to 8 pixels with the colors c0 (bit clear)
+ *  and c1 (bit set), or c0..c3 for the pixel pairs of a multicolor byte
+ */
+
+static inline void vic_expand_std(uint8 *p, uint8 data, uint8 c0, uint8 c1)
+{
+#if VIC_SIMD && defined(__SSE2__)
+	_mm_storel_epi64((__m128i *)p, vic_std_pixels(_mm_set1_epi8(data), _mm_set1_epi8(c0), _mm_set1_epi8(c1)));
+#elif VIC_SIMD
+	static const uint8 bits[8] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+	uint8x8_t mask = vtst_u8(vdup_n_u8(data), vld1_u8(bits));
+	vst1_u8(p, vbsl_u8(mask, vdup_n_u8(c1), vdup_n_u8(c0)));
+#else
+	uint8 c[2] = {c0, c1};
+	p[7] = c[data & 1]; data >>= 1;
+	p[6] = c[data & 1]; data >>= 1;
+	p[5] = c[data & 1]; data >>= 1;
+	p[4] = c[data & 1]; data >>= 1;
+	p[3] = c[data & 1]; data >>= 1;
+	p[2] = c[data & 1]; data >>= 1;
+	p[1] = c[data & 1]; data >>= 1;
+	p[0] = c[data];
+#endif
+}
+
+static inline void vic_expand_multi(uint8 *p, uint8 data, uint8 c0, uint8 c1, uint8 c2, uint8 c3)
+{
+#if VIC_SIMD && defined(__SSE2__)
+	_mm_storel_epi64((__m128i *)p, vic_multi_pixels(_mm_set1_epi8(data),
+		_mm_set1_epi8(c0), _mm_set1_epi8(c1), _mm_set1_epi8(c2), _mm_set1_epi8(c3)));
+#elif VIC_SIMD
+	static const uint8 hi_bits[8] = {0x80, 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02};
+	static const uint8 lo_bits[8] = {0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01};
+	uint8x8_t d = vdup_n_u8(data);
+	uint8x8_t lo = vtst_u8(d, vld1_u8(lo_bits));
+	vst1_u8(p, vbsl_u8(vtst_u8(d, vld1_u8(hi_bits)),
+		vbsl_u8(lo, vdup_n_u8(c3), vdup_n_u8(c2)),
+		vbsl_u8(lo, vdup_n_u8(c1), vdup_n_u8(c0))));
+#else
+	uint8 c[4] = {c0, c1, c2, c3};
+	p[7] = p[6] = c[data & 3]; data >>= 2;
+	p[5] = p[4] = c[data & 3]; data >>= 2;
+	p[3] = p[2] = c[data & 3]; data >>= 2;
+	p[1] = p[0] = c[data];
+#endif
+}
+
+
+/*
+ *  Add the foreground mask of a graphics byte to the mask bytes m[0]
+ *  and m[1], shifted right by x_scroll pixels. The standard mask of
+ *  m[1] is one pixel off, like it always was in Frodo SC, so that
+ *  collisions and priorities stay the same.
+ */
+
+static inline void vic_mask_std(uint8 *m, uint8 data, int x_scroll)
+{
+	m[0] |= data >> x_scroll;
+	m[1] |= data << (7 - x_scroll);
+}
+
+static inline void vic_mask_multi(uint8 *m, uint8 data, int x_scroll)
+{
+	uint8 fore = vic_multi_mask(data);
+	m[0] |= fore >> x_scroll;
+	m[1] |= fore << (8 - x_scroll);
+}
+
+
+/*
+ *  Expand one graphics byte and add its foreground mask to m[0..1]
+ *  at the same time (Frodo SC, one character per call)
+ */
+
+static inline void vic_expand_std_mask(uint8 *p, uint8 *m, int x_scroll, uint8 data, uint8 c0, uint8 c1)
+{
+	vic_mask_std(m, data, x_scroll);
+	vic_expand_std(p, data, c0, c1);
+}
+
+static inline void vic_expand_multi_mask(uint8 *p, uint8 *m, int x_scroll, uint8 data, uint8 c0, uint8 c1, uint8 c2, uint8 c3)
+{
+	vic_mask_multi(m, data, x_scroll);
+	vic_expand_multi(p, data, c0, c1, c2, c3);
+}
+
+
+/*
+ *  Expand the 40 multicolor graphics bytes of a line with the colors
+ *  c1..c3 per character
+ */
+
+static inline void vic_expand_multi_line(uint8 *p, const uint8 *data, uint8 c0, const uint8 *c1, const uint8 *c2, const uint8 *c3)
+{
+#if VIC_SIMD && defined(__SSE2__)
+	__m128i bg = _mm_set1_epi8(c0), d[4], x[4], y[4], z[4];
+	for (int i=0; i<40; i+=8) {
+		vic_spread8(d, data + i);
+		vic_spread8(x, c1 + i);
+		vic_spread8(y, c2 + i);
+		vic_spread8(z, c3 + i);
+		for (int j=0; j<4; j++, p+=16)
+			_mm_storeu_si128((__m128i *)p, vic_multi_pixels(d[j], bg, x[j], y[j], z[j]));
+	}
+#else
+	for (int i=0; i<40; i++, p+=8)
+		vic_expand_multi(p, data[i], c0, c1[i], c2[i], c3[i]);
+#endif
+}
+
+
+/*
+ *  Paint a sprite from its bit planes, with the first pixel in the MSB:
+ *  Pixels only in plane1 have the sprite color, only in plane0 the
+ *  multicolor 0 and in both the multicolor 1. Standard sprites only
+ *  have plane1.
+ */
+
+static inline void vic_paint_sprite(uint8 *p, uint64 plane0, uint64 plane1, uint8 color, uint8 mm0, uint8 mm1)
+{
+	const uint64 first = (uint64)1 << 63;
+
+	for (; plane0 | plane1; p++, plane0 <<= 1, plane1 <<= 1)
+		if (plane1 & first)
+			*p = plane0 & first ? mm1 : color;
+		else if (plane0 & first)
+			*p = mm0;
+}
+
+#endif
@@ -467,6 +467,13 @@ void Gui::draw(SDL_Surface *where)
 	 this->status_bar->draw(where);
 }
 
+/* Does draw() put anything on the screen? */
+bool Gui::hasOverlay(void)
+{
+	return (this->is_active && this->peekView()) || this->kbd ||
+		this->status_bar->hasMessage();
+}
+
 void Gui::activate()
 {
 	SDL_FreeSurface(this->screenshot);
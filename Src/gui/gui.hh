@@ -69,6 +69,8 @@ public:
 
 	void draw(SDL_Surface *where);
 
+	bool hasOverlay(void);
+
 	void pushView(GuiView *view);
 
 	void pushVirtualKeyboard(VirtualKeyboard *kbd);
@@ -17,6 +17,11 @@ public:
 
 	virtual void draw(SDL_Surface *where);
 
+	bool hasMessage()
+	{
+		return this->cur_message != NULL;
+	}
+
 	virtual void hoverCallback(int which) {};
 
 	virtual void selectCallback(int which) {};
@@ -184,12 +184,22 @@ extern "C" int main(int argc, char **argv)
 	DIR *dir_tmp;
 #endif
 
-	// Init SDL
-        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK) < 0) {
+	Frodo *the_app = new Frodo();
+	the_app->ArgvReceived(argc, argv);
+
+	// Color RAM and SID noise must not change between golden runs
+	if (GoldenFile)
+		srand(0);
+
+	// Init SDL, headless mode only needs the timer
+	Uint32 sdl_flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK;
+	if (HeadlessMode)
+		sdl_flags = SDL_INIT_TIMER;
+        if (SDL_Init(sdl_flags) < 0) {
                 fprintf(stderr, "Couldn't initialize SDL (%s)\n", SDL_GetError());
                 return 1;
 	}
-        if (TTF_Init() < 0)
+        if (!HeadlessMode && TTF_Init() < 0)
         {
                 fprintf(stderr, "Unable to init TTF: %s\n", TTF_GetError() );
 		return 1;
@@ -243,8 +253,6 @@ extern "C" int main(int argc, char **argv)
 	
 	#endif
 
-	Frodo *the_app = new Frodo();
-	the_app->ArgvReceived(argc, argv);
 	the_app->ReadyToRun();
 	delete the_app;
 	
@@ -278,11 +286,75 @@ Frodo::Frodo()
  */
 char *network_server_connect = 0;
 char *floppy8 = 0;
+bool HeadlessMode = false;
+int FramesToRun = 0;
+const char *AutostartFile = NULL;
+const char *BenchFile = NULL;
+const char *PrefsFile = NULL;
+const char *GoldenFile = NULL;
+bool GoldenRecord = false;
+bool PacingStats = false;
+static int num_instances = 1;	// Number of headless C64s to run side by side
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [--headless] [--frames N] [--autostart prg] [--bench file]\n"
+			"       [--check-golden file | --record-golden file] [--instances N] [--pacing-stats]\n"
+			"       [--prefs file]\n"
+			"       [floppy-image]\n", progname);
+	exit(1);
+}
 
 void Frodo::ArgvReceived(int argc, char **argv)
 {
+	const char *progname = argv[0];
+
+	// Options come before the floppy/server arguments
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strcmp(argv[1], "--headless") == 0)
+			HeadlessMode = true;
+		else if (strcmp(argv[1], "--frames") == 0 && argc > 2) {
+			FramesToRun = atoi(argv[2]);
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--autostart") == 0 && argc > 2) {
+			AutostartFile = argv[2];
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--bench") == 0 && argc > 2) {
+			BenchFile = argv[2];
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--check-golden") == 0 && argc > 2) {
+			GoldenFile = argv[2];
+			GoldenRecord = false;
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--record-golden") == 0 && argc > 2) {
+			GoldenFile = argv[2];
+			GoldenRecord = true;
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--instances") == 0 && argc > 2) {
+			num_instances = atoi(argv[2]);
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--prefs") == 0 && argc > 2) {
+			PrefsFile = argv[2];
+			argc--; argv++;
+		} else if (strcmp(argv[1], "--pacing-stats") == 0)
+			PacingStats = true;
+		else
+			usage(progname);
+		argc--; argv++;
+	}
+
 	if (argc == 2) floppy8 = argv[1];
 	else if (argc == 3) network_server_connect = argv[2];	 
+
+	// The network code reports everything through the GUI
+	if (HeadlessMode && network_server_connect) {
+		fprintf(stderr, "Networking is not available in headless mode\n");
+		network_server_connect = 0;
+	}
+
+	// Only one machine can own the window, and one the golden file
+	if (num_instances < 1 || (num_instances > 1 && (!HeadlessMode || (GoldenFile && GoldenRecord))))
+		usage(progname);
 }
 
 const char *try_path(const char *path, const char *file)
@@ -374,7 +446,13 @@ void Frodo::ReadyToRun(void)
 	if (getcwd(AppDirPath, 256) == NULL)
 		strcpy(AppDirPath, "");
 
-	this->LoadFrodorc();
+	// Golden hashes, benchmarks and headless runs are made with the
+	// default settings or the ones given on the command line, so that
+	// they don't depend on the user's frodorc
+	if (PrefsFile)
+		ThePrefs.Load(PrefsFile);
+	else if (!GoldenFile && !BenchFile && !HeadlessMode)
+		this->LoadFrodorc();
 	if (network_server_connect)
 		strncpy(ThePrefs.NetworkServer, network_server_connect,
 				sizeof(ThePrefs.NetworkServer));
@@ -423,21 +501,80 @@ if (floppy8)
 			}
 	}
 }		
-	panic_if (!init_graphics(),
-			"Can't initialize graphics!\n");
+	// Drive 8 is the directory of the autostart program
+	if (AutostartFile) {
+		const char *slash = strrchr(AutostartFile, '/');
+
+		if (slash)
+			snprintf(ThePrefs.DrivePath[0], sizeof(ThePrefs.DrivePath[0]), "%.*s",
+					(int)(slash - AutostartFile), AutostartFile);
+		else
+			strcpy(ThePrefs.DrivePath[0], ".");
+	}
+
+	if (!HeadlessMode)
+		panic_if (!init_graphics(),
+				"Can't initialize graphics!\n");
 
 	// Create and start C64
 	TheC64 = new C64;
 	DataStore::ds = new DataStore();
 	TimerController::init();
-	Gui::init();
+	if (!HeadlessMode)
+		Gui::init();
 	load_rom_files();
-	TheC64->Run();
+	if (num_instances > 1)
+		run_instances();
+	else
+		TheC64->Run();
 
 	delete TheC64;
 
 }
 
+/*
+ *  Run more headless C64s next to TheC64, each in its own thread.
+ *  The machines don't share any emulation state, only the preferences
+ *  and the ROM contents loaded for TheC64.
+ */
+
+static int run_c64(void *c64)
+{
+	((C64 *)c64)->Run();
+	return 0;
+}
+
+void Frodo::run_instances(void)
+{
+	C64 **machines = new C64 *[num_instances];
+	SDL_Thread **threads = new SDL_Thread *[num_instances];
+	int i;
+
+	machines[0] = TheC64;
+	for (i = 1; i < num_instances; i++) {
+		if (GoldenFile)
+			srand(0);	// Same power-up color RAM as TheC64
+		machines[i] = new C64;
+		memcpy(machines[i]->Basic, TheC64->Basic, BASIC_ROM_SIZE);
+		memcpy(machines[i]->Kernal, TheC64->Kernal, KERNAL_ROM_SIZE);
+		memcpy(machines[i]->Char, TheC64->Char, CHAR_ROM_SIZE);
+		memcpy(machines[i]->ROM1541, TheC64->ROM1541, DRIVE_ROM_SIZE);
+	}
+
+	for (i = 0; i < num_instances; i++) {
+		threads[i] = SDL_CreateThread(run_c64, machines[i]);
+		panic_if(!threads[i], "Can't create emulation thread: %s\n", SDL_GetError());
+	}
+	for (i = 0; i < num_instances; i++)
+		SDL_WaitThread(threads[i], NULL);
+
+	for (i = 1; i < num_instances; i++)
+		delete machines[i];
+	delete[] machines;
+	delete[] threads;
+}
+
+
 /*
  *  Determine whether path name refers to a directory
  */
@@ -26,6 +26,14 @@ class C64;
 
 // Global variables
 extern char AppDirPath[1024];	// Path of application directory
+extern bool HeadlessMode;		// Run without window, sound output and GUI
+extern int FramesToRun;			// Quit after this many frames (0: run forever)
+extern const char *AutostartFile;	// Program to LOAD and start from drive 8
+extern const char *BenchFile;		// Append speed statistics to this file on exit
+extern const char *PrefsFile;		// Preferences to use instead of the frodorc
+extern const char *GoldenFile;		// Per-frame video/sound hashes to check or record
+extern bool GoldenRecord;			// Record GoldenFile instead of checking against it
+extern bool PacingStats;			// Print frame time statistics on exit
 
 class Prefs;
 
@@ -40,6 +48,7 @@ public:
 private:
 	void load_rom(const char *which, const char *path, uint8 *where, size_t size, const uint8 *builtin);
 	void load_rom_files();
+	void run_instances(void);
 
 	static char prefs_path[256];	// Pathname of current preferences file
 };